@@ -7,6 +7,7 @@
 #ifndef _IMAGE_H
 #define _IMAGE_H
 
+#include <string>
 #include <vector>
 
 #include "matrix.h"
@@ -15,9 +16,117 @@
 #include "Shape.h"
 #include "ViewContext.h"
 #include "Triangle.h"
+#include "TriangleMesh.h"
 
 class Image{
 
+    // Homogeneous and device coordinates of one structure-of-arrays vertex set. The
+    // homogeneous coordinates are only redone when the ViewContext's 3D state changes;
+    // otherwise just the divide and 2D device transform are re-run.
+    class ProjectionCache{
+        public:
+            std::vector<float> clipX, clipY, clipW;
+            std::vector<float> deviceX, deviceY;
+            unsigned long revision;
+
+            /* 
+            * This is a default constructor for an empty ProjectionCache.
+            * 
+            * Parameters:
+            * 	none
+            */
+            ProjectionCache();
+
+            /* 
+            * Brings the homogeneous coordinates up to date for the current view, leaving the
+            * device coordinates to toDevice.
+            * 
+            * Parameters:
+            * 	vc - pointer to the ViewContext
+            *  x, y, z - model coordinates, n entries each
+            *  n - number of verticies
+            * 
+            * Returns:
+            *  void
+            */
+            void project(ViewContext* vc, const float* x, const float* y, const float* z, unsigned int n);
+
+            /* 
+            * Recomputes the device coordinates of a range of verticies from their homogeneous
+            * coordinates. Verticies behind the near plane get meaningless device coordinates.
+            * 
+            * Parameters:
+            * 	vc - pointer to the ViewContext
+            *  first - first vertex of the range
+            *  count - number of verticies in the range
+            * 
+            * Returns:
+            *  void
+            */
+            void toDevice(ViewContext* vc, unsigned int first, unsigned int count);
+
+            /* 
+            * Sizes the cache for a vertex set without projecting anything, for callers
+            * which project it a range at a time with projectRange.
+            * 
+            * Parameters:
+            * 	n - number of verticies
+            * 
+            * Returns:
+            *  void
+            */
+            void resize(unsigned int n);
+
+            /* 
+            * Recomputes the homogeneous coordinates of a range of verticies, whatever the
+            * revision they were last computed for.
+            * 
+            * Parameters:
+            * 	vc - pointer to the ViewContext
+            *  x, y, z - model coordinates of the whole vertex set
+            *  first - first vertex of the range
+            *  count - number of verticies in the range
+            * 
+            * Returns:
+            *  void
+            */
+            void projectRange(ViewContext* vc, const float* x, const float* y, const float* z,
+                              unsigned int first, unsigned int count);
+
+            /* 
+            * Recomputes both the homogeneous and device coordinates of scattered verticies,
+            * gathering them so they are still transformed as one batch.
+            * 
+            * Parameters:
+            * 	vc - pointer to the ViewContext
+            *  x, y, z - model coordinates of the whole vertex set
+            *  which - indices of the verticies to recompute
+            *  n - number of indices
+            * 
+            * Returns:
+            *  void
+            */
+            void projectScattered(ViewContext* vc, const float* x, const float* y, const float* z,
+                                  const unsigned int* which, unsigned int n);
+
+            /* 
+            * Discards the cached projection.
+            * 
+            * Parameters:
+            * 	none
+            * 
+            * Returns:
+            *  void
+            */
+            void invalidate();
+
+        private:
+            // gathered coordinates for projectScattered
+            std::vector<float> gatherX, gatherY, gatherZ;
+            std::vector<float> gatherClipX, gatherClipY, gatherClipW;
+            std::vector<float> gatherDeviceX, gatherDeviceY;
+    };
+
     public:
         /* This is default constructor for creating an Image object.
         * 
@@ -67,6 +176,7 @@ class Image{
 
         /* 
         * This method will iterate through the Image container and draw each image.
+        * The whole image is drawn as one frame of the graphics context.
         * 
         * Parameters:
         * 	gc - pointer to a graphics context object.
@@ -100,15 +210,106 @@ class Image{
 
         /**
          * Static method for reading in an image from an STL file. This method makes the 
-         * assumption that the image is made completely from triangles.
+         * assumption that the image is made completely from triangles. The stream is read
+         * into memory in one go and parsed as by readSTLFile(path).
          * 
          * Inputs:
-         *      in - reference to input stream containing STL data.
+         *      in - reference to input stream containing STL data, opened in binary mode.
          * Outputs:
          *      pointer to Image object
          */
         static Image* readSTLFile(std::istream& in);
 
+        /**
+         * Static method for reading in an image from an STL file named by its path. The
+         * file is mapped into memory and parsed in place rather than copied through a
+         * stream; anything that can not be mapped, such as a pipe, is read as a stream.
+         * The finished mesh is saved next to the file, with ".mesh" added to its name,
+         * and is mapped from there instead as long as the file keeps its size and
+         * modification time.
+         * 
+         * Inputs:
+         *      path - name of the STL file
+         * Outputs:
+         *      pointer to Image object
+         */
+        static Image* readSTLFile(const std::string& path);
+
+        /* 
+        * Returns the triangle mesh holding the faces read from an STL file.
+        * 
+        * Parameters:
+        * 	none
+        * 
+        * Returns:
+        *   reference to the mesh
+        */
+        const TriangleMesh& getMesh() const;
+
+        /* 
+        * Chooses between drawing every edge of the mesh and drawing only its feature
+        * edges: creases sharper than the crease angle, boundaries and the silhouette.
+        * 
+        * Parameters:
+        * 	featureOnly - true to draw only feature edges
+        * 
+        * Returns:
+        *   void
+        */
+        void setFeatureEdges(bool featureOnly);
+
+        /* 
+        * Returns true if only feature edges of the mesh are drawn.
+        */
+        bool getFeatureEdges() const;
+
+        /* 
+        * Sets the angle between face normals above which an edge counts as a crease.
+        * 
+        * Parameters:
+        * 	degrees - crease angle in degrees
+        * 
+        * Returns:
+        *   void
+        */
+        void setCreaseAngle(double degrees);
+
+        /* 
+        * Turns back-face culling of the mesh on or off. When on, edges are only drawn if
+        * at least one of the faces using them points toward the eye, and verticies used
+        * only by culled faces are not transformed.
+        * 
+        * Parameters:
+        * 	cull - true to cull back faces
+        * 
+        * Returns:
+        *   void
+        */
+        void setBackFaceCulling(bool cull);
+
+        /* 
+        * Returns true if back faces of the mesh are culled.
+        */
+        bool getBackFaceCulling() const;
+
+        /* 
+        * Chooses between drawing the mesh as lines and drawing its faces filled, lit from
+        * the eye. Filled faces hide each other only on graphics contexts with a depth
+        * buffer; elsewhere their outlines are drawn.
+        * 
+        * Parameters:
+        * 	solid - true to fill the faces
+        * 
+        * Returns:
+        *   void
+        */
+        void setFilled(bool solid);
+
+        /* 
+        * Returns true if the faces of the mesh are drawn filled.
+        */
+        bool getFilled() const;
+
         /* 
         * This method will erase all shapes in the Image container.
         * 
@@ -123,6 +324,199 @@ class Image{
     private:
         std::vector<Shape*> shapes;
 
+        // faces read from STL files, stored compactly rather than as Triangles
+        TriangleMesh mesh;
+        ProjectionCache meshCache;
+
+        // feature edge drawing, and whether each face pointed toward the eye at
+        // the projection revision it was last computed for
+        bool featureEdgesOnly;
+        bool backFaceCulling;
+        double creaseAngle;
+        std::vector<unsigned char> frontFacing;
+        unsigned long facingRevision;
+
+        // filled drawing, with each face's color shaded for the projection revision
+        // it was last computed for
+        bool filled;
+        std::vector<unsigned int> shadedColors;
+        unsigned long shadingRevision;
+        ProjectionCache faceCache;
+
+        // the edges selected for drawing, as pairs of indices into a compact copy of
+        // just the verticies they use, so that nothing else is transformed
+        std::vector<unsigned int> visibleEdges;
+        std::vector<unsigned int> visibleColors;
+        std::vector<unsigned int> compactIndex;
+        std::vector<float> visibleX, visibleY, visibleZ;
+        unsigned long visibleRevision;
+        bool visibleDirty;
+
+        // where each cluster's edges and verticies start in the lists above, with
+        // one extra entry marking the end of the last cluster. Each compact vertex
+        // belongs to the first cluster using it; the ones a cluster shares with
+        // earlier clusters are listed in sharedVerticies.
+        std::vector<unsigned int> clusterEdgeStart;
+        std::vector<unsigned int> clusterVertexStart;
+        std::vector<unsigned int> clusterSharedStart;
+        std::vector<unsigned int> sharedVerticies;
+        std::vector<unsigned int> vertexCluster;
+
+        // the projection revision each cluster's own verticies were last projected
+        // for, and which clusters are in view this frame
+        std::vector<unsigned long> clusterRevision;
+        std::vector<unsigned char> clusterVisible;
+
+        // shared verticies whose own cluster is out of view, projected on their own
+        std::vector<unsigned int> strayVerticies;
+
+        // device space lines handed to the graphics context a color at a time
+        std::vector<GraphicsContext::Segment> segments;
+        std::vector<unsigned int> segmentColors;
+
+        // the model coordinates of every shape, gathered once so that all shapes
+        // can be transformed in a single batch
+        std::vector<float> modelX, modelY, modelZ;
+        bool modelCached;
+        ProjectionCache shapeCache;
+
+        /* 
+        * Private helper which draws the mesh, as lines or filled faces.
+        * 
+        * Parameters:
+        * 	gc - pointer to a graphics context object.
+        *  vc - pointer to the view context.
+        * 
+        * Returns:
+        *   void
+        */
+        void drawMesh(GraphicsContext* gc, ViewContext* vc);
+
+        /* 
+        * Private helper which draws the faces of the mesh filled, nearest first where
+        * the graphics context has a depth buffer.
+        * 
+        * Parameters:
+        * 	gc - pointer to a graphics context object.
+        *  vc - pointer to the view context.
+        * 
+        * Returns:
+        *   void
+        */
+        void drawFaces(GraphicsContext* gc, ViewContext* vc);
+
+        /* 
+        * Private helper which brings the shaded face colors up to date for the current
+        * eye position.
+        * 
+        * Parameters:
+        *  vc - pointer to the view context.
+        * 
+        * Returns:
+        *   void
+        */
+        void updateShading(ViewContext* vc);
+
+        /* 
+        * Private helper which brings the per-face front facing flags up to date for
+        * the current eye position.
+        * 
+        * Parameters:
+        *  vc - pointer to the view context.
+        * 
+        * Returns:
+        *   void
+        */
+        void updateFacing(ViewContext* vc);
+
+        /* 
+        * Private helper which chooses the mesh edges to draw for the current view and
+        * drawing mode, and gathers the verticies they use.
+        * 
+        * Parameters:
+        *  vc - pointer to the view context.
+        * 
+        * Returns:
+        *   void
+        */
+        void selectEdges(ViewContext* vc);
+
+        /* 
+        * Private helper which draws the individual shapes.
+        * 
+        * Parameters:
+        * 	gc - pointer to a graphics context object.
+        *  vc - pointer to the view context.
+        * 
+        * Returns:
+        *   void
+        */
+        void drawShapes(GraphicsContext* gc, ViewContext* vc);
+
+        /* 
+        * Private helper which gathers the model coordinates of every shape into the
+        * structure-of-arrays cache.
+        * 
+        * Parameters:
+        * 	none
+        * 
+        * Returns:
+        *   void
+        */
+        void gatherModelCoordinates();
+
+        /* 
+        * Private helper which discards the cached coordinates. Must be called whenever
+        * the shapes or mesh in the image change.
+        * 
+        * Parameters:
+        * 	none
+        * 
+        * Returns:
+        *   void
+        */
+        void invalidateCache();
+
+        /**
+         * Private helper building an image from the bytes of an STL file. Both ASCII and
+         * binary STL are read; a file is taken as binary when its size matches the facet
+         * count in its header, or when its header is not text starting with "solid".
+         * 
+         * Inputs:
+         *      data - the contents of the file
+         *      size - number of bytes in data
+         * Outputs:
+         *      pointer to Image object
+         */
+        static Image* readSTL(const char* data, size_t size);
+
+        /**
+         * Private helper which reads the facets of an ASCII STL file into the mesh. Large
+         * files are split into chunks at facet boundaries. The facets in each chunk are
+         * counted so that the mesh can be sized once, then the chunks are parsed at the same
+         * time, each on its own thread, a block at a time into their own range of the mesh.
+         * 
+         * Inputs:
+         *      p - start of the text of the file
+         *      end - end of the text of the file
+         * Outputs:
+         *      none
+         */
+        void readASCIISTL(const char* p, const char* end);
+
+        /**
+         * Private helper which reads the facets of a binary STL file into the mesh. The mesh
+         * is sized once for all of them, then each block of facets is decoded into a small
+         * buffer and set in its place.
+         * 
+         * Inputs:
+         *      data - the facets, just after the 84 byte header
+         *      facets - number of facets held in data
+         * Outputs:
+         *      none
+         */
+        void readBinarySTL(const char* data, unsigned int facets);
+
 };
 
 #endif
@@ -0,0 +1,220 @@
+/**
+ * Mat.h - Fixed size matrix template. Unlike the matrix class, the size of a Mat
+ * is part of its type, so Mats live on the stack, need no heap allocation, and
+ * size mismatches are caught by the compiler rather than at runtime. Element
+ * access is unchecked and every operation is constexpr, with multiplication
+ * fully unrolled at compile time.
+ */
+
+#ifndef MAT_H
+#define MAT_H
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "matrix.h"
+
+template<unsigned int R, unsigned int C, typename T = double>
+class Mat {
+    public:
+
+        /**
+         * Default constructor. All elements are set to zero.
+         * Input:
+         *      none
+         * Output:
+         *      new Mat object
+         */
+        constexpr Mat() : elements{} {}
+
+        /**
+         * Element constructor. Elements are given in row-major order and all R*C
+         * must be supplied, e.g. Vec4(x, y, z, 1).
+         * Input:
+         *      values - R*C element values in row-major order
+         * Output:
+         *      new Mat object
+         */
+        template<typename... Args,
+                 typename = typename std::enable_if<sizeof...(Args) == R * C && (R * C > 1)>::type>
+        constexpr explicit Mat(Args... values) : elements{static_cast<T>(values)...} {}
+
+        /**
+         * Conversion constructor from a runtime sized matrix.
+         * Input:
+         *      from - matrix to copy, must be R x C
+         * Output:
+         *      new Mat object
+         * Throws:
+         *      matrixException - thrown if from is not R x C
+         */
+        explicit Mat(const matrix& from) : elements{} {
+            if(from.getRows() != R || from.getCols() != C){
+                throw matrixException("Mat conversion from a matrix of the wrong size.");
+            }
+            for(unsigned int i = 0; i < R; i++){
+                for(unsigned int j = 0; j < C; j++){
+                    elements[i * C + j] = from[i][j];
+                }
+            }
+        }
+
+        /**
+         * Named constructor for the identity matrix. Only available for square Mats.
+         * Input:
+         *      none
+         * Output:
+         *      new Mat object
+         */
+        static constexpr Mat identity() {
+            static_assert(R == C, "identity requires a square Mat");
+            Mat result;
+            for(unsigned int i = 0; i < R; i++){
+                result.elements[i * C + i] = T(1);
+            }
+            return result;
+        }
+
+        /**
+         * Row access. Returns a pointer to the first element of the requested row so
+         * that elements may be addressed as m[row][col]. No bounds checking is done.
+         * Input:
+         *      row - row to access
+         * Output:
+         *      pointer to first element of row
+         */
+        constexpr T* operator[](unsigned int row) { return elements + row * C; }
+        constexpr const T* operator[](unsigned int row) const { return elements + row * C; }
+
+        /**
+         * Raw access to the row-major element storage.
+         * Input:
+         *      none
+         * Output:
+         *      pointer to first element
+         */
+        constexpr T* data() { return elements; }
+        constexpr const T* data() const { return elements; }
+
+        /**
+         * Matrix multiplication. The product is expanded at compile time into R*K
+         * dot products of length C, with no loops or branches.
+         * Input:
+         *      rhs - C x K Mat on the right of the product
+         * Output:
+         *      new R x K Mat
+         */
+        template<unsigned int K>
+        constexpr Mat<R, K, T> operator*(const Mat<C, K, T>& rhs) const {
+            return multiply(rhs, std::make_index_sequence<R * K>{});
+        }
+
+        /**
+         * Scalar multiplication.
+         * Input:
+         *      scale - value to multiply each element by
+         * Output:
+         *      new Mat object
+         */
+        constexpr Mat operator*(T scale) const {
+            Mat result;
+            for(unsigned int i = 0; i < R * C; i++){
+                result.elements[i] = elements[i] * scale;
+            }
+            return result;
+        }
+
+        /**
+         * Matrix addition.
+         * Input:
+         *      rhs - Mat to add to this one
+         * Output:
+         *      new Mat object
+         */
+        constexpr Mat operator+(const Mat& rhs) const {
+            Mat result;
+            for(unsigned int i = 0; i < R * C; i++){
+                result.elements[i] = elements[i] + rhs.elements[i];
+            }
+            return result;
+        }
+
+        /**
+         * Transpose of a Mat.
+         * Input:
+         *      none
+         * Output:
+         *      new C x R Mat
+         */
+        constexpr Mat<C, R, T> operator~() const {
+            Mat<C, R, T> result;
+            for(unsigned int i = 0; i < R; i++){
+                for(unsigned int j = 0; j < C; j++){
+                    result[j][i] = elements[i * C + j];
+                }
+            }
+            return result;
+        }
+
+        /**
+         * Converts to a runtime sized matrix, for interop with code still using the
+         * matrix class.
+         * Input:
+         *      none
+         * Output:
+         *      new R x C matrix object
+         */
+        matrix toMatrix() const {
+            matrix result(R, C);
+            for(unsigned int i = 0; i < R; i++){
+                for(unsigned int j = 0; j < C; j++){
+                    result[i][j] = elements[i * C + j];
+                }
+            }
+            return result;
+        }
+
+    private:
+        template<unsigned int, unsigned int, typename> friend class Mat;
+
+        T elements[R * C];
+
+        /**
+         * Private helper which expands one output element per index in I.
+         */
+        template<unsigned int K, std::size_t... I>
+        constexpr Mat<R, K, T> multiply(const Mat<C, K, T>& rhs, std::index_sequence<I...>) const {
+            Mat<R, K, T> result;
+            ((result.elements[I] = dotRowCol<K>(rhs, I / K, I % K, std::make_index_sequence<C>{})), ...);
+            return result;
+        }
+
+        /**
+         * Private helper which expands the dot product of a row of this Mat with a
+         * column of rhs.
+         */
+        template<unsigned int K, std::size_t... J>
+        constexpr T dotRowCol(const Mat<C, K, T>& rhs, std::size_t row, std::size_t col,
+                              std::index_sequence<J...>) const {
+            return ((elements[row * C + J] * rhs.elements[J * K + col]) + ...);
+        }
+};
+
+/**
+ * Global scalar multiplication, allowing 5.0 * someMat.
+ */
+template<unsigned int R, unsigned int C, typename T>
+constexpr Mat<R, C, T> operator*(T scale, const Mat<R, C, T>& rhs){
+    return rhs * scale;
+}
+
+// column vectors and the sizes used by the transform pipeline
+template<unsigned int R, typename T = double>
+using Vec = Mat<R, 1, T>;
+
+typedef Mat<4, 4> Mat4;
+typedef Vec<4> Vec4;
+typedef Vec<3> Vec3;
+
+#endif
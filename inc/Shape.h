@@ -165,6 +165,45 @@ class Shape{
 
         virtual void draw(GraphicsContext*, ViewContext*)=0;
 
+        /* 
+        * Returns the number of verticies that make up the shape.
+        * 
+        * Parameters:
+        * 	none
+        * 
+        * Returns:
+        *  number of verticies
+        */
+        virtual unsigned int vertexCount() const=0;
+
+        /* 
+        * Copies the model coordinates of the shape verticies into structure-of-arrays buffers so that
+        * a whole image can be transformed in one batch.
+        * 
+        * Parameters:
+        * 	x, y, z - arrays of at least vertexCount() entries receiving the coordinates
+        * 
+        * Returns:
+        *  void
+        */
+        virtual void getModelCoordinates(float* x, float* y, float* z) const=0;
+
+        /* 
+        * Draws the shape from homogeneous coordinates which have already been computed by
+        * ViewContext::modelToClip from the coordinates given by getModelCoordinates. The shape
+        * clips itself against the near plane before mapping to device coordinates.
+        * 
+        * Parameters:
+        * 	gc - pointer to graphics context object
+        *  vc - pointer to the view context
+        *  clipX, clipY, clipW - homogeneous coordinates of the verticies, vertexCount() entries each
+        * 
+        * Returns:
+        *  void
+        */
+        virtual void drawClip(GraphicsContext* gc, const ViewContext* vc, const float* clipX,
+                              const float* clipY, const float* clipW) const=0;
+
         /* 
         * This method will print the properties of the Shape to an output stream
         * 
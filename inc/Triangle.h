@@ -100,6 +100,43 @@ class Triangle : public Shape{
         */
         void draw(GraphicsContext*, ViewContext*);
 
+        /* 
+        * Returns the number of verticies that make up the Triangle, which is always 3.
+        * 
+        * Parameters:
+        * 	none
+        * 
+        * Returns:
+        *  number of verticies
+        */
+        unsigned int vertexCount() const;
+
+        /* 
+        * Copies the model coordinates of the Triangle verticies into structure-of-arrays buffers.
+        * 
+        * Parameters:
+        * 	x, y, z - arrays of at least 3 entries receiving the coordinates
+        * 
+        * Returns:
+        *  void
+        */
+        void getModelCoordinates(float* x, float* y, float* z) const;
+
+        /* 
+        * Draws the Triangle outline from precomputed homogeneous coordinates, clipping each
+        * edge against the near plane.
+        * 
+        * Parameters:
+        * 	gc - pointer to graphics context object
+        *  vc - pointer to the view context
+        *  clipX, clipY, clipW - homogeneous coordinates of the 3 verticies
+        * 
+        * Returns:
+        *  void
+        */
+        void drawClip(GraphicsContext* gc, const ViewContext* vc, const float* clipX,
+                      const float* clipY, const float* clipW) const;
+
         /* 
         * This method will print the properties of the Triangle to an output stream
         * 
@@ -0,0 +1,358 @@
+/**
+ * TriangleMesh.h - Interface for the TriangleMesh class, a compact structure-of-arrays
+ * store for large triangle models such as those read from STL files. Instead of one
+ * heap allocated Triangle per face, coordinates live in contiguous float arrays and
+ * colors in a packed per-face array. The mesh is indexed: each face refers to its
+ * three corners through an index buffer, so once weld() has merged duplicate
+ * verticies a corner shared by several faces is stored - and transformed - once.
+ * A finished mesh can be saved to a file which is later mapped into memory and
+ * used in place, without reading it.
+ */
+
+#ifndef _TRIANGLEMESH_H
+#define _TRIANGLEMESH_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class TriangleMesh{
+
+    public:
+        // marks the missing second face of an edge on the boundary of the mesh
+        static const unsigned int NO_FACE = 0xFFFFFFFF;
+
+        // number of consecutive faces grouped under one bounding box
+        static const unsigned int CLUSTER_SIZE = 256;
+
+        /*
+        * This is a default constructor for an empty TriangleMesh.
+        *
+        * Parameters:
+        * 	none
+        */
+        TriangleMesh();
+
+        /*
+        * Appends a face to the mesh. Each call adds three new verticies; call weld() once
+        * all faces are added to merge the duplicates.
+        *
+        * Parameters:
+        * 	x, y, z - model coordinates of the 3 corners of the face
+        *  color - 24-bit RGB color of the face
+        *
+        * Returns:
+        *  void
+        */
+        void addFace(const float* x, const float* y, const float* z, unsigned int color);
+
+        /*
+        * Appends a face with a known normal to the mesh. Normals are optional, but once
+        * any face has one every face is expected to.
+        *
+        * Parameters:
+        * 	x, y, z - model coordinates of the 3 corners of the face
+        *  color - 24-bit RGB color of the face
+        *  nx, ny, nz - face normal
+        *
+        * Returns:
+        *  void
+        */
+        void addFace(const float* x, const float* y, const float* z, unsigned int color,
+                     float nx, float ny, float nz);
+
+        /*
+        * Appends a block of faces with known normals to the mesh, growing the arrays once
+        * for the whole block rather than a face at a time.
+        *
+        * Parameters:
+        * 	corners - model coordinates, 9 per face: x, y and z of each corner in turn
+        *  normals - face normals, 3 per face
+        *  count - number of faces
+        *  color - 24-bit RGB color of every face
+        *
+        * Returns:
+        *  void
+        */
+        void addFaces(const float* corners, const float* normals, unsigned int count, unsigned int color);
+
+        /*
+        * Sets the number of faces in the mesh. New faces get three verticies of their own,
+        * the given color and zero normals, to be filled in with setFaces().
+        *
+        * Parameters:
+        * 	faces - number of faces the mesh is to hold
+        *  color - 24-bit RGB color of the new faces
+        *
+        * Returns:
+        *  void
+        */
+        void resize(unsigned int faces, unsigned int color);
+
+        /*
+        * Overwrites the corners and normals of a range of faces added by addFaces() or
+        * resize() and not yet welded. Threads may fill separate ranges at the same time,
+        * so unlike the other changes this does not copy a mapped mesh out of its file -
+        * resize() and addFaces() already have, and nothing may map one in meanwhile.
+        *
+        * Parameters:
+        * 	first - index of the first face to set
+        *  corners - model coordinates, 9 per face: x, y and z of each corner in turn
+        *  normals - face normals, 3 per face
+        *  count - number of faces
+        *
+        * Returns:
+        *  void
+        */
+        void setFaces(unsigned int first, const float* corners, const float* normals, unsigned int count);
+
+        /*
+        * Reserves storage for a number of faces, avoiding reallocation while a model
+        * of known size is read.
+        *
+        * Parameters:
+        * 	faces - number of faces to reserve space for
+        *
+        * Returns:
+        *  void
+        */
+        void reserve(unsigned int faces);
+
+        /*
+        * Merges verticies with identical coordinates into one and rewrites the index buffer
+        * to match. STL files repeat every shared vertex in each facet using it, so on closed
+        * meshes this typically leaves one vertex for every two faces.
+        *
+        * Parameters:
+        * 	none
+        *
+        * Returns:
+        *  void
+        */
+        void weld();
+
+        /*
+        * Builds the list of unique edges from the index buffer. An edge shared by two faces
+        * appears once, so a wireframe drawn from the edge list rasterizes every line exactly
+        * once. Edges are ordered by the first face using them, which groups them by
+        * cluster. Must be called again after the faces or index buffer change.
+        *
+        * Parameters:
+        * 	none
+        *
+        * Returns:
+        *  void
+        */
+        void buildEdges();
+
+        /*
+        * Makes sure every face has a unit normal. Normals read from the file are kept and
+        * normalized; faces without one, or whose normal is zero, not a number or points
+        * against the face's counter-clockwise winding, get the normal implied by the winding.
+        *
+        * Parameters:
+        * 	none
+        *
+        * Returns:
+        *  void
+        */
+        void computeNormals();
+
+        /*
+        * Splits the edge list into feature edges - edges on the boundary of the mesh or
+        * between faces whose normals differ by more than creaseAngle degrees - and smooth
+        * edges. Requires buildEdges() and computeNormals() to have been called.
+        *
+        * Parameters:
+        * 	creaseAngle - minimum angle in degrees between face normals for an edge to
+        *                 count as a feature
+        *
+        * Returns:
+        *  void
+        */
+        void findFeatureEdges(double creaseAngle);
+
+        /*
+        * Computes the axis-aligned bounding box of the whole mesh and of each cluster of
+        * CLUSTER_SIZE consecutive faces, so that parts of the mesh out of view can be
+        * skipped without looking at their faces.
+        *
+        * Parameters:
+        * 	none
+        *
+        * Returns:
+        *  void
+        */
+        void computeBounds();
+
+        /*
+        * Writes the mesh to a file which map() can use in place. Each array is stored
+        * in the byte order of this machine in its own aligned section. The mesh must be
+        * finished: welded, with its edges, normals, feature edges and bounds found.
+        *
+        * Parameters:
+        * 	path - name of the file to write
+        *  sourceSize, sourceTime - size and modification time in nanoseconds of the
+        *                           file the mesh was read from
+        *
+        * Returns:
+        *  true if the file was written
+        */
+        bool save(const std::string& path, unsigned long long sourceSize, long long sourceTime) const;
+
+        /*
+        * Replaces the mesh with one written by save(), mapping the file into memory and
+        * using its arrays where they lie rather than reading them. They are copied out
+        * only if the mesh is changed. Files from another version of this format,
+        * another byte order or another version of the source are not used.
+        *
+        * Parameters:
+        * 	path - name of the file to map
+        *  sourceSize, sourceTime - size and modification time in nanoseconds of the
+        *                           file the mesh was read from
+        *
+        * Returns:
+        *  true if the mesh was mapped, false if it is unchanged
+        */
+        bool map(const std::string& path, unsigned long long sourceSize, long long sourceTime);
+
+        /*
+        * Removes all faces from the mesh.
+        *
+        * Parameters:
+        * 	none
+        *
+        * Returns:
+        *  void
+        */
+        void clear();
+
+        /*
+        * Returns the crease angle in degrees of the last call to findFeatureEdges().
+        */
+        double getCreaseAngle() const;
+
+        /*
+        * Returns the number of faces in the mesh.
+        */
+        unsigned int getFaceCount() const;
+
+        /*
+        * Returns the number of verticies in the mesh.
+        */
+        unsigned int getVertexCount() const;
+
+        /*
+        * Returns pointers to the vertex coordinate arrays, getVertexCount() entries each.
+        */
+        const float* getX() const;
+        const float* getY() const;
+        const float* getZ() const;
+
+        /*
+        * Returns a pointer to the index buffer, 3 * getFaceCount() entries. Face f uses
+        * verticies getIndices()[3f], [3f+1] and [3f+2].
+        */
+        const unsigned int* getIndices() const;
+
+        /*
+        * Returns the number of unique edges found by buildEdges().
+        */
+        unsigned int getEdgeCount() const;
+
+        /*
+        * Returns a pointer to the edge list, 2 * getEdgeCount() entries. Edge e joins
+        * verticies getEdges()[2e] and [2e+1].
+        */
+        const unsigned int* getEdges() const;
+
+        /*
+        * Returns a pointer to the faces on either side of each edge, 2 * getEdgeCount()
+        * entries. The second face of an edge on the boundary of the mesh is NO_FACE.
+        */
+        const unsigned int* getEdgeFaces() const;
+
+        /*
+        * Returns a pointer to one flag per edge, set by findFeatureEdges() for feature
+        * edges. The others are only drawn in feature mode when they lie on the silhouette.
+        */
+        const unsigned char* getFeatureFlags() const;
+
+        /*
+        * Returns the number of face clusters, each of CLUSTER_SIZE faces except perhaps
+        * the last. Face f is in cluster f / CLUSTER_SIZE.
+        */
+        unsigned int getClusterCount() const;
+
+        /*
+        * Returns a pointer to the cluster bounding boxes found by computeBounds(), six
+        * floats per cluster: minimum x, y and z followed by maximum x, y and z.
+        */
+        const float* getClusterBounds() const;
+
+        /*
+        * Returns a pointer to the bounding box of the whole mesh, laid out as a cluster
+        * bounding box.
+        */
+        const float* getBounds() const;
+
+        /*
+        * Returns a pointer to the packed per-face colors, getFaceCount() entries.
+        */
+        const unsigned int* getColors() const;
+
+        /*
+        * Returns true if per-face normals are stored.
+        */
+        bool hasNormals() const;
+
+        /*
+        * Returns pointers to the per-face normal arrays, getFaceCount() entries each,
+        * or empty arrays if hasNormals() is false.
+        */
+        const float* getNormalX() const;
+        const float* getNormalY() const;
+        const float* getNormalZ() const;
+
+    private:
+        // A mesh file mapped into memory by map(), whose arrays stand in for those
+        // below until the mesh is changed. Copies of the mesh share the mapping.
+        struct Mapping{
+            void* data;
+            size_t size;
+            const float *x, *y, *z;
+            const unsigned int *indices, *colors, *edges, *edgeFaces;
+            const float *normalX, *normalY, *normalZ, *clusterBounds;
+            unsigned int vertexCount, faceCount, edgeCount;
+            bool normals;
+
+            Mapping(void* data, size_t size);
+            ~Mapping();
+        };
+
+        std::shared_ptr<const Mapping> mapping;
+        std::vector<float> x, y, z;
+        std::vector<unsigned int> indices;
+        std::vector<unsigned int> colors;
+        std::vector<unsigned int> edges;
+        std::vector<unsigned int> edgeFaces;
+        std::vector<unsigned char> featureFlags;
+        std::vector<float> clusterBounds;
+        float bounds[6];
+        std::vector<float> normalX, normalY, normalZ;
+        double featureAngle;
+
+        /*
+        * Copies the arrays of a mapped mesh into the mesh's own storage and releases
+        * the mapping, so that they can be changed.
+        *
+        * Parameters:
+        * 	none
+        *
+        * Returns:
+        *  void
+        */
+        void detach();
+};
+
+#endif
@@ -11,6 +11,7 @@
 #include <cmath>
 
 #include "matrix.h"
+#include "Mat.h"
 #include "Shape.h"
 
 #define PI 3.14159265359
@@ -19,6 +20,10 @@ class Shape;
 
 class ViewContext {
     public:
+        // the near clipping plane, as the smallest w = (zf - z) / zf kept: a hundredth of
+        // the way from the eye to the view origin, where points appear 100 times larger
+        static constexpr double NEAR_PLANE = 0.01;
+
 
         /* 
         * This is a constructor for the ViewContext object. The ViewContext object requires that the reference
@@ -68,6 +73,103 @@ class ViewContext {
         */
         matrix* modelToDevice(matrix*);
 
+        /* 
+        * First stage of the batch transform: applies the 3D view transform and produces homogeneous
+        * coordinates x, y and w = (zf - z) / zf, where z is the view depth. The perspective divide is
+        * left to clipToDevice so that edges can first be clipped against the near plane. The result
+        * only depends on the orbit state and FOV, so it stays valid for as long as
+        * getProjectionRevision is unchanged.
+        * 
+        * Inputs:
+        *      x, y, z - model coordinates of the verticies, n entries each
+        *      n - number of verticies
+        *      clipX, clipY, clipW - caller supplied arrays of n entries which receive the homogeneous
+        *                            coordinates
+        * Outputs:
+        *      none, but contents of clipX, clipY and clipW are changed
+        */
+        void modelToClip(const float* x, const float* y, const float* z, unsigned int n,
+                         float* clipX, float* clipY, float* clipW) const;
+
+        /* 
+        * Second stage of the batch transform: performs the perspective divide on coordinates produced
+        * by modelToClip and applies the 2D scale, rotate and translate, in one pass. Verticies behind
+        * the near plane must have been clipped first; their device coordinates are meaningless.
+        * 
+        * Inputs:
+        *      clipX, clipY, clipW - homogeneous coordinates, n entries each
+        *      n - number of verticies
+        *      deviceX, deviceY - caller supplied arrays of n entries which receive the device coordinates
+        * Outputs:
+        *      none, but contents of deviceX and deviceY are changed
+        */
+        void clipToDevice(const float* clipX, const float* clipY, const float* clipW, unsigned int n,
+                          float* deviceX, float* deviceY) const;
+
+        /* 
+        * Clips an edge in homogeneous coordinates against the near plane w = NEAR_PLANE. An end behind
+        * the plane is moved along the edge onto it.
+        * 
+        * Inputs:
+        *      x, y, w - homogeneous coordinates of the two ends of the edge, 2 entries each
+        * Outputs:
+        *      false if the whole edge is behind the near plane, in which case nothing is changed
+        */
+        static bool clipToNearPlane(float* x, float* y, float* w);
+
+        /* 
+        * Clips a convex polygon in homogeneous coordinates against the near plane w = NEAR_PLANE,
+        * keeping the part in front of it.
+        * 
+        * Inputs:
+        *      x, y, w - homogeneous coordinates of the corners in order, n entries each
+        *      n - number of corners
+        *      outX, outY, outW - caller supplied arrays of n + 1 entries which receive the corners
+        *                         of the clipped polygon
+        * Outputs:
+        *      number of corners of the clipped polygon, 0 if it is wholly behind the near plane
+        */
+        static unsigned int clipToNearPlane(const float* x, const float* y, const float* w, unsigned int n,
+                                            float* outX, float* outY, float* outW);
+
+        /* 
+        * Returns a number identifying the current 3D view state (orbit, basis and FOV). It changes every
+        * time that state changes, and is never repeated by any ViewContext, so callers caching the output
+        * of modelToClip can compare it against the revision they cached with.
+        * 
+        * Inputs:
+        *      none
+        * Outputs:
+        *      current projection revision, never 0
+        */
+        unsigned long getProjectionRevision() const;
+
+        /* 
+        * Returns the position of the eye (the center of projection) in model coordinates, taking the
+        * current orbit into account. A face whose normal points towards this position is facing the
+        * viewer.
+        * 
+        * Inputs:
+        *      none
+        * Outputs:
+        *      eye position in model coordinates
+        */
+        Vec3 getEyePosition() const;
+
+        /* 
+        * Tests an axis-aligned box in model coordinates against the view frustum: the part of space
+        * in front of the near plane that the view basis, orbit, projection distance zf and current 2D
+        * transform map into a window of the given size. The test is conservative - it may accept a box that is just out of view,
+        * but never rejects one with any part in view.
+        * 
+        * Inputs:
+        *      box - minimum x, y and z followed by maximum x, y and z
+        *      width, height - size of the window in pixels
+        * Outputs:
+        *      false if nothing in the box can be seen
+        */
+        bool boxVisible(const float* box, int width, int height) const;
+
         /* 
         * This function applies a scale to the exisiting transformation matrix, while simultaneously updating the 
         * inverse transformation matrix.
@@ -115,7 +217,8 @@ class ViewContext {
 
         /**
          * This function acepts the 3D matrix and projects the points into 2D space. This changes the
-         * x and y values, but does not change the z values.
+         * x and y values, but does not change the z values. Points behind the near plane are held on
+         * it rather than clipped.
          * 
          * Inputs:
          *      a - pointer to matrix on which to perform 2D projection
@@ -124,6 +227,16 @@ class ViewContext {
          */
         void project(matrix* a);
 
+        /**
+         * Fixed size overload of project for the three verticies of a triangle.
+         * 
+         * Inputs:
+         *      a - reference to verticies on which to perform 2D projection
+         * Outputs:
+         *      none, but contents of a are changed
+         */
+        void project(Mat<4,3>& a) const;
+
         /**
          * Interface method for changing the field of view.
          * 
@@ -155,19 +268,26 @@ class ViewContext {
         void vOrbit(double degrees);
 
     private:
-        matrix* toModelCoordinates;
-        matrix* toDeviceCoordinates;
+        Mat4 toModelCoordinates;
+        Mat4 toDeviceCoordinates;
 
-        matrix* changeBasisMatrix;
+        Mat4 changeBasisMatrix;
 
-        matrix* hOrbitMatrix;
-        matrix* vOrbitMatrix;
+        Mat4 hOrbitMatrix;
+        Mat4 vOrbitMatrix;
 
-        matrix* translateToOrigin;
-        matrix* translateFromOrigin;
+        Mat4 translateToOrigin;
+        Mat4 translateFromOrigin;
 
-        matrix* p0;
-        matrix* pref;
+        // changeBasisMatrix * vOrbitMatrix * hOrbitMatrix, rebuilt on demand
+        // whenever one of its factors has changed
+        mutable Mat4 cachedViewMatrix;
+        mutable bool viewDirty;
+
+        unsigned long projectionRevision;
+
+        Vec3 p0;
+        Vec3 pref;
         double zf;
 
         double mi;
@@ -181,43 +301,67 @@ class ViewContext {
          * matricies.
          * 
          * Inputs:
-         *      a - pointer to the matrix on the left
-         *      b - pointer to the matrix on the right
+         *      a - reference to the vector on the left
+         *      b - reference to the vector on the right
          * Outputs:
-         *      resulting matrix from cross product.
+         *      resulting vector from cross product.
          */
-        matrix crossProduct3X1(matrix* a, matrix* b);
+        static Vec3 crossProduct3X1(const Vec3& a, const Vec3& b);
 
         /**
          * This is a private helper method for normalizing a matrix.
          * 
          * Input:
-         *      a - pointer to matrix to be normalized.
+         *      a - reference to vector to be normalized.
          * Output:
-         *      resulting normalized matrix
+         *      resulting normalized vector
          */
-        matrix normalize(matrix* a);
+        static Vec3 normalize(const Vec3& a);
 
         /**
          * Private helper method for determining the dot product of 2 3X1 matricies
          * 
          * Input:
-         *      a - pointer to matrix on the left
-         *      b - pointer to matrix on the right
+         *      a - reference to vector on the left
+         *      b - reference to vector on the right
          * Output:
          *      result of dot product
          */
-        double dot(matrix*a, matrix* b);
+        static double dot(const Vec3& a, const Vec3& b);
 
         /**
          * Determines the magnitude of a 3X1 matrix.
          * 
          * Input:
-         *  a - pointer to matrix
+         *  a - reference to vector
+         * Output:
+         *      magnitude of vector
+         */
+        static double magnitude(const Vec3& a);
+
+        /**
+         * This is a private helper which returns the orbit and change of basis matricies composed
+         * into the single matrix taking model coordinates to view coordinates. The product is cached
+         * and only recomputed after one of the matricies has changed.
+         * 
+         * Input:
+         *      none
          * Output:
-         *      magnitude of matrix
+         *      composed view matrix
+         */
+        const Mat4& viewMatrix() const;
+
+        /**
+         * This is a private helper which marks the cached view matrix as stale and starts a new
+         * projection revision. It must be called whenever hOrbitMatrix, vOrbitMatrix,
+         * changeBasisMatrix or zf changes.
+         * 
+         * Input:
+         *      none
+         * Output:
+         *      none
          */
-        double magnitude(matrix* a);
+        void invalidateView();
 
         /**
          * This is a private method for transforming to a new basis for 3D rendering.
@@ -0,0 +1,199 @@
+#ifndef FB_CONTEXT
+#define FB_CONTEXT
+/**
+ * This class is an implementation of the GraphicsContext class which
+ * draws into a block of memory rather than a window.  No display is
+ * needed, so it can render and be benchmarked on servers without one.
+ * Pixels are 32-bit 0x00RRGGBB values stored row by row.
+ *
+ * Since there is no user, runLoop takes its events from a script
+ * queued up with pushEvent or loadScript.
+ *
+ * Filled triangles are binned into 64x64 pixel tiles and, inside a
+ * frame, rasterized by a pool of threads a tile at a time when the
+ * frame ends or anything else is drawn.
+ * */
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "gcontext.h"	// base class
+
+class FramebufferContext : public GraphicsContext
+{
+	public:
+		// The kinds of event a script can contain.  Besides the events
+		// a window would deliver, SAVE writes the framebuffer to a PPM
+		// file and QUIT ends the loop.
+		enum eventType {EXPOSE, KEY_DOWN, KEY_UP, BUTTON_DOWN,
+						BUTTON_UP, MOUSE_MOVE, SAVE, QUIT};
+
+		// One scripted event.  code is the keysym of key events or the
+		// button of button events, and path is the file for SAVE.
+		struct Event
+		{
+			eventType type;
+			unsigned int code;
+			int x;
+			int y;
+			std::string path;
+		};
+
+		// Default Constructor
+		FramebufferContext(unsigned int sizex,unsigned int sizey,unsigned int bg_color);
+
+		// Constructor rendering into memory owned by the caller, such as
+		// an image shared with a display server.  memory must hold
+		// sizex*sizey pixels and outlive the context.
+		FramebufferContext(unsigned int sizex,unsigned int sizey,unsigned int bg_color,
+						unsigned int* memory);
+
+		// Destructor
+		virtual ~FramebufferContext();
+
+		// Drawing Operations
+		void setMode(drawMode newMode);
+		void setColor(unsigned int color);
+		void setPixel(int x, int y);
+		void drawLine(int x0, int y0, int x1, int y1);
+		void drawCircle(int x0, int y0, unsigned int radius);
+		unsigned int getPixel(int x, int y);
+		void clear();
+
+		// Batch operations, written straight to memory
+		void fillSpan(int y, int x0, int x1);
+		void drawLines(const Segment* segments, unsigned int n);
+		void setPixels(const Point* points, unsigned int n);
+
+		// Half-space rasterizer tested against a 32-bit float depth
+		// buffer, which is only allocated once a triangle is filled
+		void fillTriangle(const float* x, const float* y, const float* depth);
+
+		// Frame operations - inside a frame filled triangles are queued
+		// and rasterized in parallel
+		void beginFrame();
+		void endFrame();
+
+		// Sets the number of threads rasterizing tiles, including the
+		// one drawing, at most 4 per hardware thread.  Defaults to the
+		// number of hardware threads.
+		void setThreadCount(unsigned int count);
+
+		// Event looop functions - runs until the script is exhausted,
+		// a QUIT event is reached or endLoop is called
+		void runLoop(DrawingBase* drawing);
+
+		// we will use endLoop provided by base class
+
+		// Utility functions
+		int getWindowWidth();
+		int getWindowHeight();
+
+		// Appends an event to the script
+		void pushEvent(const Event& event);
+
+		// Appends the events in a text script to the queue, one per line:
+		//     expose
+		//     key <k>          (key down and up)
+		//     keydown <k>      keyup <k>
+		//     press <button> <x> <y>
+		//     release <button> <x> <y>
+		//     move <x> <y>
+		//     drag <x0> <y0> <x1> <y1> <steps>
+		//     save <file.ppm>
+		//     quit
+		// where <k> is a single character, left/up/right/down or a
+		// numeric keysym.  Blank lines and lines starting with # are
+		// skipped.  Returns false if a line could not be understood.
+		bool loadScript(std::istream& script);
+
+		// Direct access to the pixels, getWindowWidth()*getWindowHeight()
+		// of them, row by row from the top left corner
+		const unsigned int* getPixels() const;
+
+		// Writes the framebuffer as a binary PPM image
+		void writePPM(std::ostream& os) const;
+
+	private:
+		// edge length in pixels of the square tiles triangles are
+		// binned into
+		static const int TILE_SIZE = 64;
+
+		// A triangle ready to rasterize.  Each edge function a*x + b*y
+		// + c is non-negative at the center of pixels (x, y) inside it,
+		// and the depth there is depthA*x + depthB*y + depthC.
+		struct TriangleSetup
+		{
+			long long a[3], b[3], c[3];
+			double depthA, depthB, depthC;
+			int minX, maxX, minY, maxY;
+			unsigned int color;
+			drawMode mode;
+		};
+
+		int width;
+		int height;
+		unsigned int background;
+		unsigned int color;
+		drawMode mode;
+		unsigned int* pixels;
+		std::vector<unsigned int> storage;	// unused with caller's memory
+		std::deque<Event> events;
+		std::vector<float> depthBuffer;	// tile by tile, empty until needed
+		bool depthDirty;				// written since the last clear
+		bool inFrame;
+
+		// triangles queued for rasterizing, and the indices of those
+		// touching each tile
+		int tilesX;
+		int tilesY;
+		std::vector<TriangleSetup> triangles;
+		std::vector<std::vector<unsigned int> > bins;
+		std::vector<unsigned int> activeTiles;
+		std::atomic<unsigned int> nextTile;
+
+		// worker threads, woken for each new generation of work
+		unsigned int threadCount;
+		std::vector<std::thread> workers;
+		std::mutex poolMutex;
+		std::condition_variable poolWake;
+		std::condition_variable poolDone;
+		unsigned long generation;
+		unsigned int busyWorkers;
+		bool stopping;
+
+		// Sets up the state shared by both constructors
+		void init();
+
+		// Sets a pixel known to be on screen, honouring the draw mode
+		void plot(int x, int y);
+
+		// Sets a pixel if it is on screen
+		void plotClipped(int x, int y);
+
+		// Queues a triangle in the bins of the tiles it touches.
+		// Returns false if it is not on screen.
+		bool setupTriangle(const float* x, const float* y, const float* depth);
+
+		// Rasterizes and empties the queued triangles
+		void flushTriangles();
+
+		// Rasterizes tiles until there are none left, on any thread
+		void rasterizeTiles();
+
+		// Rasterizes the triangles binned into one tile
+		void rasterizeTile(unsigned int tile);
+
+		// Worker thread management
+		void startWorkers();
+		void stopWorkers();
+		void workerLoop(unsigned long seen);
+};
+
+#endif
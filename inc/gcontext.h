@@ -59,11 +59,40 @@ class GraphicsContext
 		static const unsigned int LIGHT_BROWN = 0xCD853F;
 		static const unsigned int GREY = 0x808080;
 
+		// A line from (x0, y0) to (x1, y1) and a single pixel, for the
+		// batch drawing operations
+		struct Segment
+		{
+			int x0, y0, x1, y1;
+		};
+
+		struct Point
+		{
+			int x, y;
+		};
+
+		/* Converts a line in floating point device coordinates to a
+		 * Segment.  Coordinates far outside the window are first clipped
+		 * to a guard band, since converting a float out of the range of
+		 * an int is undefined.
+		 * 
+		 * Parameters:
+		 * 	x0, y0 - origin of line
+		 *  x1, y1 - end of line
+		 *  segment - the converted line
+		 * 
+		 * Returns: false if the line misses the guard band or is not a number
+		 */
+		static bool toSegment(float x0, float y0, float x1, float y1, Segment& segment);
+
 	
 	
 		/*********************************************************
 		 * Construction / Destruction
 		 *********************************************************/
+		// Sets up the pixel buffer used by the naive algorithms
+		GraphicsContext();
+
 		// Implementations of this class should include a constructor
 		// that creates the drawing canvas (window), sets a background
 		// color (which may be configurable), sets a default drawing
@@ -126,6 +155,63 @@ class GraphicsContext
 		 */
 		virtual void drawCircle(int x0, int y0, unsigned int radius);
 
+		// These draw many pixels for the price of one call.  The
+		// versions here fall back on setPixel and drawLine, so a
+		// context should override them with direct memory writes or
+		// bulk requests where it can.
+
+		/* Sets every pixel of a horizontal run to the current color.
+		 * 
+		 * Parameters:
+		 * 	y - row of the span
+		 *  x0, x1 - first and last column, in either order
+		 * 
+		 * Returns: void
+		 */
+		virtual void fillSpan(int y, int x0, int x1);
+
+		/* Draws a number of lines in the current color.
+		 * 
+		 * Parameters:
+		 * 	segments - the lines to draw
+		 *  n - number of lines
+		 * 
+		 * Returns: void
+		 */
+		virtual void drawLines(const Segment* segments, unsigned int n);
+
+		/* Sets a number of pixels to the current color.
+		 * 
+		 * Parameters:
+		 * 	points - the pixels to set
+		 *  n - number of pixels
+		 * 
+		 * Returns: void
+		 */
+		virtual void setPixels(const Point* points, unsigned int n);
+
+		/* Fills a triangle in the current color.  Contexts with a depth
+		 * buffer only draw the parts nearer than what is already there;
+		 * the depth buffer is reset by clear.  This version has no depth
+		 * buffer and draws the outline instead.
+		 * 
+		 * Parameters:
+		 * 	x, y - device coordinates of the 3 corners
+		 *  depth - depth of each corner, interpolated linearly across
+		 *          the triangle; larger values are nearer
+		 * 
+		 * Returns: void
+		 */
+		virtual void fillTriangle(const float* x, const float* y, const float* depth);
+
+		// Brackets the drawing of one frame.  Between the two calls a
+		// context may queue drawing operations instead of performing
+		// them immediately, as long as everything drawn is visible once
+		// endFrame returns.  Frames do not nest.  The default versions
+		// do nothing.
+		virtual void beginFrame();
+		virtual void endFrame();
+
 
 		/*********************************************************
 		 * Event loop operations
@@ -157,7 +243,46 @@ class GraphicsContext
 		// continues to run.
 		bool run;
 
+		/* Clips a line to the pixels 0 <= x < width, 0 <= y < height
+		 * using the Cohen-Sutherland algorithm, so that only the visible
+		 * part is rasterized.  Lines already inside are left untouched.
+		 * 
+		 * Parameters:
+		 * 	x0, y0 - origin of line, moved onto the window if needed
+		 *  x1, y1 - end of line, moved onto the window if needed
+		 *  width, height - size of the window
+		 * 
+		 * Returns: false if no part of the line is in the window
+		 */
+		static bool clipLine(int& x0, int& y0, int& x1, int& y1, int width, int height);
+
 	private:
+		// pixels produced by the naive line and circle algorithms, passed
+		// on to setPixels a block at a time
+		static const unsigned int PIXEL_BUFFER_SIZE = 256;
+		Point pixelBuffer[PIXEL_BUFFER_SIZE];
+		unsigned int pixelCount;
+
+		/* This is a helper function which adds a pixel to the pixel buffer,
+		* passing the buffer to setPixels when it is full.
+		* 
+		* Parameters:
+		* 	x, y - pixel to set
+		* 
+		* Returns: void
+		*/
+		void bufferPixel(int x, int y);
+
+		/* This is a helper function which passes any buffered pixels to
+		* setPixels.
+		* 
+		* Parameters:
+		* 	none
+		* 
+		* Returns: void
+		*/
+		void flushPixels();
+
 		/* This is a helper function which determines the octant that a line
 		* lies in space.
 		* 
@@ -93,6 +93,10 @@ class matrix
  
 		// Copy constructor - make a new Matrix just like rhs
 		matrix(const matrix& from);
+
+		// Move constructor - take ownership of the storage of from, leaving
+		// from as an empty 0x0 matrix that may only be destroyed or assigned
+		matrix(matrix&& from) noexcept;
  
 		// Destructor.  Free allocated memory
 		~matrix();
@@ -100,6 +104,10 @@ class matrix
 		// Assignment operator - make this just like rhs.  Must function
         // correctly even if rhs is a different size than this.
 		matrix& operator=(const matrix& rhs);
+
+		// Move assignment - release our storage and take ownership of the
+		// storage of rhs, leaving rhs as an empty 0x0 matrix
+		matrix& operator=(matrix&& rhs) noexcept;
  
 		// "Named" constructor(s).  This is not a language mechanism, rather
 		// a common programming idiom.  The underlying issue is that with
@@ -144,6 +152,10 @@ class matrix
  
 		// Clear Matrix to all members 0.0
 		void clear();
+
+		// Dimensions of the matrix
+		unsigned int getRows() const;
+		unsigned int getCols() const;
   
 		// Access Operators - throw an exception if index out of range
 		//
@@ -181,22 +193,21 @@ class matrix
 		
 		
 	private:
-		// The data - note, per discussion on arrays, you can store these data
-		// as a 1-D dynamic array, thus the matrix_row* below.  Alternatively, and
-		// perhaps preferred, you could store the data as an array of arrays
-		// which would require the_Matrix to be changed to a matrix_row**.
-		double** the_matrix;
+		// The data - stored as a single contiguous 1-D dynamic array in
+		// row-major order, so element [r][c] lives at the_matrix[r*cols + c].
+		// One allocation per matrix keeps copies and temporaries cheap.
+		double* the_matrix;
 		unsigned int rows;
 		unsigned int cols;
 
 		/** routines **/
 
-		//Private helper function to erase the underlying 2D array. This is made
+		//Private helper function to erase the underlying array. This is made
 		//private so that the destructor can utalize the functionality, as well
 		//as matrix methods that need the the object to remain instantiated.
 		void erase();
 
-		//private helper function so that the underlying 2D array can be called
+		//private helper function so that the underlying array can be called
 		//from matrix methods. This is necessary in the = operator override
 		void createEmptyMatrix(int rows, int cols);
 		// add any "helper" routine here, such as routines to support
@@ -0,0 +1,64 @@
+/**
+ * matrix_kernels.h - Vectorized kernels for the 4x4 products that dominate the
+ * transform pipeline: composing transforms and applying them to vertex buffers.
+ * SSE2, AVX2 and AVX-512 versions are compiled into the program and the widest
+ * one the CPU supports is chosen once at startup. A portable scalar version is
+ * always available as a fallback.
+ *
+ * All matricies are row-major arrays of doubles with no padding between rows.
+ */
+
+#ifndef MATRIX_KERNELS_H
+#define MATRIX_KERNELS_H
+
+/**
+ * Multiplies two 4x4 matricies.
+ * Input:
+ *      a - 16 doubles, left hand side
+ *      b - 16 doubles, right hand side
+ *      out - 16 doubles receiving a * b, must not alias a or b
+ * Output:
+ *      none, but contents of out are changed
+ */
+void mat4Multiply(const double* a, const double* b, double* out);
+
+/**
+ * Multiplies a 4x4 matrix by a 4xN matrix.
+ * Input:
+ *      a - 16 doubles, left hand side
+ *      b - 4*n doubles, right hand side
+ *      out - 4*n doubles receiving a * b, must not alias a or b
+ *      n - number of columns in b and out
+ * Output:
+ *      none, but contents of out are changed
+ */
+void mat4MultiplyN(const double* a, const double* b, double* out, unsigned int n);
+
+/**
+ * Transforms points by the top three rows of a 4x4 matrix, as the product of the
+ * matrix with (x, y, z, 1). Points are stored as floats and worked on as doubles,
+ * and every kernel set gives the same results.
+ * Input:
+ *      m - 16 doubles, the transform; the bottom row is not used
+ *      x, y, z - coordinates of the points, n entries each
+ *      n - number of points
+ *      outX, outY, outZ - n entries receiving the transformed coordinates, which
+ *                         may be the same arrays as x, y and z
+ * Output:
+ *      none, but contents of outX, outY and outZ are changed
+ */
+void mat4TransformPoints(const double* m, const float* x, const float* y, const float* z, unsigned int n,
+                         float* outX, float* outY, float* outZ);
+
+/**
+ * Reports which kernel set was selected at startup. Setting the environment
+ * variable MATRIX_KERNELS to scalar, sse2, avx2 or avx512 before starting the
+ * program forces a particular set, provided the CPU supports it.
+ * Input:
+ *      none
+ * Output:
+ *      name of the selected kernel set
+ */
+const char* matrixKernelName();
+
+#endif
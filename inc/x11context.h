@@ -6,7 +6,10 @@
  * */    
  
 #include <X11/Xlib.h>   // Every Xlib program must include this
+#include <X11/extensions/XShm.h>	// shared memory images
+#include <vector>
 #include "gcontext.h"	// base class
+#include "fbcontext.h"	// software rendering
 
 class X11Context : public GraphicsContext
 {
@@ -26,6 +29,35 @@ class X11Context : public GraphicsContext
 		unsigned int getPixel(int x, int y);
 		void clear();
 
+		// Batch operations, sent as single requests
+		void fillSpan(int y, int x0, int x1);
+		void drawLines(const Segment* segments, unsigned int n);
+		void setPixels(const Point* points, unsigned int n);
+
+		// Filled with a depth buffer when rendering in software, and
+		// drawn as an outline otherwise
+		void fillTriangle(const float* x, const float* y, const float* depth);
+
+		// Frame operations - inside a frame lines and pixels are queued
+		// per color and sent in bulk at endFrame, with a single flush
+		void beginFrame();
+		void endFrame();
+
+		// Turns the back buffer on or off.  With it on, drawing goes to
+		// an off-screen pixmap and each finished frame is copied to the
+		// window at once, so partly drawn frames are never seen and
+		// exposed areas are restored from the last frame rather than
+		// by repainting the scene.
+		void setBackBuffer(bool enable);
+
+		// Turns software rendering on or off.  With it on, drawing is
+		// done in process memory and each finished frame is sent to the
+		// window as one image - through shared memory when the server
+		// supports MIT-SHM, or with a plain XPutImage when it does not.
+		// Returns false if the display's pixel format is not 32-bit RGB,
+		// in which case drawing is left as it was.
+		bool setSoftwareRendering(bool enable);
+
 		// Event looop functions
 		void runLoop(DrawingBase* drawing);		
 		
@@ -42,6 +74,82 @@ class X11Context : public GraphicsContext
 		Window window;
 		GC graphics_context;
 
+		// Size of the window, kept up to date from ConfigureNotify events
+		// so that it can be asked for without a round trip
+		int windowWidth;
+		int windowHeight;
+
+		// Where drawing goes - the window, or the back buffer if there
+		// is one
+		Drawable target;
+		Pixmap backBuffer;
+		unsigned int bufferWidth;
+		unsigned int bufferHeight;
+		bool framePresented;
+		unsigned int background;
+		drawMode mode;
+
+		// Software rendering - a FramebufferContext drawing into the
+		// memory of frameImage, shared with the server if shmAttached
+		FramebufferContext* software;
+		XImage* frameImage;
+		XShmSegmentInfo shmInfo;
+		bool shmAttached;
+		unsigned int shmPending;	// images sent but not yet read
+		int shmCompletion;	// its event type
+
+		// Drawing queued during a frame, grouped by color
+		struct Batch
+		{
+			unsigned int color;
+			std::vector<XSegment> segments;
+			std::vector<XPoint> points;
+		};
+
+		unsigned int color;
+		bool inFrame;
+		std::vector<Batch> batches;
+		size_t lastBatch;
+
+		// largest number of segments or points sent in one request
+		size_t maxSegments;
+		size_t maxPoints;
+
+		// Returns the batch for the current color
+		Batch& currentBatch();
+
+		// Sends all queued drawing to the server, without flushing
+		void submit();
+
+		// Creates the back buffer at the size of the window, replacing
+		// any previous one, and fills it with the background
+		void createBackBuffer();
+
+		// Fills the back buffer with the background color
+		void clearBackBuffer();
+
+		// Creates the software rendering image at the size of the window,
+		// replacing any previous one
+		bool createImage();
+
+		// Releases the software rendering image
+		void destroyImage();
+
+		// Returns the software framebuffer, once the server has finished
+		// reading it for the last image sent
+		FramebufferContext* softwareTarget();
+
+		// Event predicate for XIfEvent matching the ShmCompletion of an
+		// image sent to the window of the context passed in arg
+		static Bool isShmCompletion(Display* display, XEvent* event, XPointer arg);
+
+		// Copies an area of the back buffer or software image to the
+		// window
+		void present(int x, int y, unsigned int width, unsigned int height);
+
+		// Makes drawing done outside of a frame visible
+		void finishImmediate();
+
 };
 
 #endif
@@ -8,12 +8,90 @@
 
 #include "Image.h"
 
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// default angle between face normals above which an edge is drawn in feature mode
+static const double DEFAULT_CREASE_ANGLE = 30.0;
+
+// marks a mesh vertex not used by any of the edges being drawn
+static const unsigned int NO_VERTEX = 0xFFFFFFFF;
+
+// share of a filled face's color shown however it is turned from the eye
+static const double AMBIENT_LIGHT = 0.2;
+
+// layout of binary STL files: an 80 byte header and 4 byte facet count, then
+// 50 bytes for each facet, read a block at a time
+static const int STL_HEADER_SIZE = 84;
+static const int STL_FACET_SIZE = 50;
+static const unsigned int STL_BLOCK_FACETS = 4096;
+
+// added to the name of an STL file to name the mesh saved from it
+static const char MESH_FILE_SUFFIX[] = ".mesh";
+
+// least amount of ASCII STL text worth parsing on a thread of its own
+static const size_t STL_CHUNK_SIZE = 1 << 20;
+
+/*
+ * Private helper giving the most threads an ASCII STL file is parsed on: one per
+ * hardware thread, unless the STL_THREADS environment variable asks for another
+ * number, which lets the chunked parse be checked on any machine.
+ */
+static unsigned int readThreads(){
+    const char* requested = std::getenv("STL_THREADS");
+    if(requested != nullptr){
+        unsigned int threads = 0;
+        std::from_chars_result result = std::from_chars(requested, requested + std::strlen(requested), threads);
+        if(result.ec == std::errc() && *result.ptr == '\0' && threads > 0){
+            return threads;
+        }
+    }
+    return std::thread::hardware_concurrency();
+}
+
+/*
+ * Private helper assembling a 32 bit little-endian value, whatever the byte order
+ * of the host.
+ */
+static inline uint32_t readLittleEndian(const unsigned char* bytes){
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) |
+           ((uint32_t)bytes[3] << 24);
+}
+
+/*
+ * Private helper reading a little-endian IEEE single precision float.
+ */
+static inline float readLittleEndianFloat(const unsigned char* bytes){
+    const uint32_t bits = readLittleEndian(bytes);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
 /* This is default constructor for creating an Image object.
  * 
  * Parameters:
  *      none
  */
-Image::Image(){}
+Image::Image(){
+    featureEdgesOnly = false;
+    backFaceCulling = false;
+    creaseAngle = DEFAULT_CREASE_ANGLE;
+    filled = false;
+    invalidateCache();
+}
 
 /* This is a copy constructor for the image class. This will create deep copies of all
  * shapes in the image class
@@ -29,6 +107,12 @@ Image::Image(const Image& im){
     }
 
     shapes = temp;
+    mesh = im.mesh;
+    featureEdgesOnly = im.featureEdgesOnly;
+    backFaceCulling = im.backFaceCulling;
+    creaseAngle = im.creaseAngle;
+    filled = im.filled;
+    invalidateCache();
 }
 
 /* This is a destructor for an Image object. This will call destructors for all
@@ -52,13 +136,21 @@ Image::~Image(){
  *  a reference to an Image.
  */
 Image& Image::operator=(const Image& im){
-    for(std::vector<Shape*>::const_iterator iter(shapes.begin()); iter != shapes.end(); ++iter){
-        delete *iter;
+    if(this == &im){
+        return *this;
     }
 
+    erase();
+
     for(std::vector<Shape*>::const_iterator iter(im.shapes.begin()); iter != im.shapes.end(); ++iter){
         shapes.push_back(&(*iter)->clone());
     }
+    mesh = im.mesh;
+    featureEdgesOnly = im.featureEdgesOnly;
+    backFaceCulling = im.backFaceCulling;
+    creaseAngle = im.creaseAngle;
+    filled = im.filled;
+    invalidateCache();
 
     return *this;
 }
@@ -74,10 +166,12 @@ Image& Image::operator=(const Image& im){
  */
 void Image::add(Shape * shape){
     shapes.push_back(&shape->clone());
+    invalidateCache();
 }
 
 /* 
  * This method will iterate through the Image container and draw each image.
+ * The whole image is drawn as one frame of the graphics context.
  * 
  * Parameters:
  * 	gc - pointer to a graphics context object.
@@ -86,10 +180,11 @@ void Image::add(Shape * shape){
  *  void
  */
 void Image::draw(GraphicsContext* gc, ViewContext* vc){
+    gc->beginFrame();
     gc->clear();
-    for(std::vector<Shape*>::const_iterator iter(shapes.begin()); iter != shapes.end(); ++iter){
-        (*iter)->draw(gc, vc);
-    }
+    drawMesh(gc, vc);
+    drawShapes(gc, vc);
+    gc->endFrame();
 }
 
 /* 
@@ -104,6 +199,16 @@ void Image::draw(GraphicsContext* gc, ViewContext* vc){
 std::ostream& Image::out(std::ostream& os){
     os << "Begin Image" << std::endl;
     os << "Begin Shapes" << std::endl;
+    for(unsigned int f = 0; f < mesh.getFaceCount(); f++){
+        matrix verticies(4,3);
+        for(int i = 0; i < 3; i++){
+            const unsigned int v = mesh.getIndices()[f * 3 + i];
+            verticies[0][i] = mesh.getX()[v];
+            verticies[1][i] = mesh.getY()[v];
+            verticies[2][i] = mesh.getZ()[v];
+        }
+        Triangle(&verticies, mesh.getColors()[f]).out(os);
+    }
     for(std::vector<Shape*>::const_iterator iter(shapes.begin()); iter != shapes.end(); ++iter){
         (*iter)->out(os);
     }
@@ -123,7 +228,7 @@ std::ostream& Image::out(std::ostream& os){
  *  pointer to image object
  */
 Image* Image::in(std::istream& iStream){
-    Image * image;
+    Image * image = nullptr;
     while(!iStream.eof()){
         std::string line;
 
@@ -141,43 +246,394 @@ Image* Image::in(std::istream& iStream){
 
 /**
  * Static method for reading in an image from an STL file. This method makes the 
- * assumption that the image is made completely from triangles.
+ * assumption that the image is made completely from triangles. The stream is read
+ * into memory in one go and parsed as by readSTLFile(path).
  * 
  * Inputs:
- *      in - reference to input stream containing STL data.
+ *      in - reference to input stream containing STL data, opened in binary mode.
  * Outputs:
  *      pointer to Image object
  */
 Image* Image::readSTLFile(std::istream& in){
-    
-    int vertexes = 0;
-    std::string line;
-    std::vector<Shape*> shapes;
-    matrix m1(4,3);
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    const std::string data = buffer.str();
+    return readSTL(data.data(), data.size());
+}
+
+/**
+ * Static method for reading in an image from an STL file named by its path. The
+ * file is mapped into memory and parsed in place rather than copied through a
+ * stream; anything that can not be mapped, such as a pipe, is read as a stream.
+ * The finished mesh is saved next to the file, with ".mesh" added to its name,
+ * and is mapped from there instead as long as the file keeps its size and
+ * modification time.
+ * 
+ * Inputs:
+ *      path - name of the STL file
+ * Outputs:
+ *      pointer to Image object
+ */
+Image* Image::readSTLFile(const std::string& path){
+    const int fd = open(path.c_str(), O_RDONLY);
+    struct stat info;
+    void* data = MAP_FAILED;
+    unsigned long long size = 0;
+    long long time = 0;
+
+    if(fd >= 0 && fstat(fd, &info) == 0 && S_ISREG(info.st_mode)){
+        size = info.st_size;
+        time = info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+
+        Image* image = new Image();
+        if(image->mesh.map(path + MESH_FILE_SUFFIX, size, time)){
+            close(fd);
+            if(image->mesh.getCreaseAngle() != image->creaseAngle){
+                image->mesh.findFeatureEdges(image->creaseAngle);
+            }
+            image->invalidateCache();
+            return image;
+        }
+        delete image;
+
+        if(size > 0){
+            data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+    }
+    if(fd >= 0){
+        // the mapping outlives the descriptor
+        close(fd);
+    }
+
+    if(data == MAP_FAILED){
+        std::ifstream file(path, std::ios::in | std::ios::binary);
+        return readSTLFile(file);
+    }
+
+    madvise(data, size, MADV_SEQUENTIAL);
+    Image* image = readSTL(static_cast<const char*>(data), size);
+    munmap(data, size);
+
+    // a mesh file that can not be written, say in a read-only directory, is skipped
+    image->mesh.save(path + MESH_FILE_SUFFIX, size, time);
+    return image;
+}
+
+/**
+ * Private helper building an image from the bytes of an STL file. Both ASCII and
+ * binary STL are read; a file is taken as binary when its size matches the facet
+ * count in its header, or when its header is not text starting with "solid".
+ * 
+ * Inputs:
+ *      data - the contents of the file
+ *      size - number of bytes in data
+ * Outputs:
+ *      pointer to Image object
+ */
+Image* Image::readSTL(const char* data, size_t size){
     Image* image = new Image();
-    
-    while(getline(in,line)){
-        if(line.find("endfacet")!=std::string::npos){
-            image->add(new Triangle(&m1, GraphicsContext::WHITE));
-            m1.clear();
+
+    // 80 byte header followed by the facet count. Binary files may start with
+    // "solid" too, so the size is the more reliable test.
+    bool binary = false;
+    unsigned int facets = 0;
+
+    if(size >= (size_t)STL_HEADER_SIZE){
+        facets = readLittleEndian(reinterpret_cast<const unsigned char*>(data) + 80);
+
+        bool text = std::strncmp(data, "solid", 5) == 0;
+        for(int i = 0; i < STL_HEADER_SIZE && text; i++){
+            text = std::isprint((unsigned char)data[i]) || std::isspace((unsigned char)data[i]);
+        }
+
+        binary = !text || size == STL_HEADER_SIZE + STL_FACET_SIZE * (uint64_t)facets;
+    }
+
+    if(binary){
+        // a file cut short keeps the facets it holds
+        const size_t present = (size - STL_HEADER_SIZE) / STL_FACET_SIZE;
+        image->readBinarySTL(data + STL_HEADER_SIZE, std::min<size_t>(facets, present));
+    }else{
+        image->readASCIISTL(data, data + size);
+    }
+
+    image->mesh.weld();
+    image->mesh.buildEdges();
+    image->mesh.computeNormals();
+    image->mesh.findFeatureEdges(image->creaseAngle);
+    image->mesh.computeBounds();
+    image->invalidateCache();
+    return image;
+}
+
+/*
+ * Private helpers for walking the text of an ASCII STL file without copying it.
+ * Each takes the current position and the end of the text and returns the new
+ * position.
+ */
+static inline bool isSpace(char c){
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+static inline const char* skipSpace(const char* p, const char* end){
+    while(p < end && isSpace(*p)){
+        p++;
+    }
+    return p;
+}
+
+static inline const char* skipWord(const char* p, const char* end){
+    while(p < end && !isSpace(*p)){
+        p++;
+    }
+    return p;
+}
+
+static inline const char* skipLine(const char* p, const char* end){
+    const char* line = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return line ? line + 1 : end;
+}
+
+/*
+ * Parses the number following p, leaving value untouched if there is none.
+ */
+static inline const char* parseFloat(const char* p, const char* end, float& value){
+    p = skipSpace(p, end);
+    const char* first = (p < end && *p == '+') ? p + 1 : p;
+    std::from_chars_result result = std::from_chars(first, end, value);
+    return result.ptr == first ? p : result.ptr;
+}
+
+static inline bool isKeyword(const char* word, size_t length, const char* keyword, size_t keywordLength){
+    return length == keywordLength && std::memcmp(word, keyword, length) == 0;
+}
+
+/*
+ * Private helper parsing ASCII STL facets into corners and normals laid out as for
+ * TriangleMesh::addFaces(), stopping once capacity facets are read. Missing numbers
+ * are left zero for corners and not a number for normals.
+ */
+static const char* parseASCIIFacets(const char* p, const char* end, float* corners, float* normals,
+                                    unsigned int capacity, unsigned int& count){
+    int vertexes = 0;
+    count = 0;
+    std::fill(corners, corners + 9, 0.0f);
+    std::fill(normals, normals + 3, NAN);
+
+    while(count < capacity && (p = skipSpace(p, end)) < end){
+        const char* word = p;
+        p = skipWord(p, end);
+        const size_t length = p - word;
+
+        if(isKeyword(word, length, "vertex", 6)){
+            // extra verticies in a facet are ignored
+            if(vertexes < 3){
+                for(int i = 0; i < 3; i++){
+                    p = parseFloat(p, end, corners[count * 9 + vertexes * 3 + i]);
+                }
+            }
+            vertexes++;
+        }else if(isKeyword(word, length, "facet", 5)){
+            // facet normal nx ny nz - bad or missing values are recomputed from the
+            // winding once the mesh is complete
+            p = skipWord(skipSpace(p, end), end);
+            for(int i = 0; i < 3; i++){
+                p = parseFloat(p, end, normals[count * 3 + i]);
+            }
+        }else if(isKeyword(word, length, "endfacet", 8)){
             vertexes = 0;
-        }else if(line.find("facet")!=std::string::npos){
-        }else if(line.find("vertex")!=std::string::npos){
-            std::istringstream iss(line);
-            std::vector<std::string> tokens;
+            if(++count < capacity){
+                std::fill(corners + count * 9, corners + count * 9 + 9, 0.0f);
+                std::fill(normals + count * 3, normals + count * 3 + 3, NAN);
+            }
+        }else if(isKeyword(word, length, "solid", 5) || isKeyword(word, length, "endsolid", 8)){
+            // the rest of the line is the name of the solid
+            p = skipLine(p, end);
+        }
+        // outer loop and endloop carry nothing
+    }
+    return p;
+}
 
-            copy(std::istream_iterator<std::string>(iss),
-                 std::istream_iterator<std::string>(),
-                 std::back_inserter(tokens));
+/*
+ * Private helper finding the first "endfacet" keyword at or after p, or end if there
+ * is none.
+ */
+static const char* findEndfacet(const char* p, const char* begin, const char* end){
+    static const char KEYWORD[] = "endfacet";
+    const char* found = p;
+    while((found = std::search(found, end, KEYWORD, KEYWORD + 8)) != end){
+        const char* after = found + 8;
+        if((found == begin || isSpace(found[-1])) && (after == end || isSpace(*after))){
+            return found;
+        }
+        found = after;
+    }
+    return end;
+}
+
+/*
+ * Private helper finding the first point at or after p just past an "endfacet",
+ * where a parse can start as if it had read everything before it.
+ */
+static const char* nextFacet(const char* p, const char* begin, const char* end){
+    const char* found = findEndfacet(p, begin, end);
+    return found == end ? end : found + 8;
+}
+
+/*
+ * Private helper counting the "endfacet" keywords from p to end, which is the number
+ * of facets parseASCIIFacets() reads there unless the name of a solid holds one.
+ */
+static unsigned int countFacets(const char* p, const char* begin, const char* end){
+    unsigned int count = 0;
+    while((p = findEndfacet(p, begin, end)) != end){
+        count++;
+        p += 8;
+    }
+    return count;
+}
+
+/**
+ * Private helper which reads the facets of an ASCII STL file into the mesh. Large
+ * files are split into chunks at facet boundaries. The facets in each chunk are
+ * counted so that the mesh can be sized once, then the chunks are parsed at the same
+ * time, each on its own thread, a block at a time into their own range of the mesh.
+ * 
+ * Inputs:
+ *      p - start of the text of the file
+ *      end - end of the text of the file
+ * Outputs:
+ *      none
+ */
+void Image::readASCIISTL(const char* p, const char* end){
+    const char* const begin = p;
+    const size_t size = end - p;
+    const unsigned int chunks = std::max<size_t>(1, std::min<size_t>(readThreads(), size / STL_CHUNK_SIZE));
 
-            for(unsigned int i = 1; i < tokens.size(); i++){
-                m1[i-1][vertexes] = stoi(tokens.at(i));
+    auto parseAll = [&](){
+        std::vector<float> corners(STL_BLOCK_FACETS * 9);
+        std::vector<float> normals(STL_BLOCK_FACETS * 3);
+        while(p < end){
+            unsigned int count;
+            p = parseASCIIFacets(p, end, corners.data(), normals.data(), STL_BLOCK_FACETS, count);
+            mesh.addFaces(corners.data(), normals.data(), count, GraphicsContext::WHITE);
+        }
+    };
+
+    if(chunks == 1){
+        parseAll();
+        return;
+    }
+
+    std::vector<const char*> starts(chunks + 1, end);
+    starts[0] = p;
+    for(unsigned int i = 1; i < chunks; i++){
+        starts[i] = nextFacet(std::max(p + size / chunks * i, starts[i - 1]), p, end);
+    }
+
+    // the number of faces in each chunk, and then the index of the first in the mesh
+    std::vector<unsigned int> firstFace(chunks + 1, 0);
+    std::vector<unsigned char> mismatched(chunks, 0);
+
+    auto count = [&](unsigned int chunk){
+        firstFace[chunk + 1] = countFacets(starts[chunk], begin, starts[chunk + 1]);
+    };
+
+    auto parse = [&](unsigned int chunk){
+        std::vector<float> corners(STL_BLOCK_FACETS * 9);
+        std::vector<float> normals(STL_BLOCK_FACETS * 3);
+        const char* q = starts[chunk];
+        unsigned int face = firstFace[chunk];
+
+        while(q < starts[chunk + 1]){
+            const unsigned int capacity = std::min(STL_BLOCK_FACETS, firstFace[chunk + 1] - face);
+            unsigned int parsed;
+            q = parseASCIIFacets(q, starts[chunk + 1], corners.data(), normals.data(),
+                                 capacity == 0 ? STL_BLOCK_FACETS : capacity, parsed);
+            if(capacity == 0){
+                // anything left should hold no more facets than were counted
+                mismatched[chunk] = parsed > 0;
+                break;
             }
+            mesh.setFaces(face, corners.data(), normals.data(), parsed);
+            face += parsed;
+        }
 
-            vertexes++;
+        if(face != firstFace[chunk + 1]){
+            mismatched[chunk] = 1;
         }
+    };
+
+    auto inParallel = [&](auto work){
+        // the calling thread takes the first chunk itself
+        std::vector<std::thread> threads;
+        for(unsigned int i = 1; i < chunks; i++){
+            threads.emplace_back(work, i);
+        }
+        work(0);
+        for(std::thread& thread : threads){
+            thread.join();
+        }
+    };
+
+    inParallel(count);
+
+    // each chunk's faces follow those of the chunks before it
+    firstFace[0] = mesh.getFaceCount();
+    for(unsigned int i = 0; i < chunks; i++){
+        firstFace[i + 1] += firstFace[i];
+    }
+    mesh.resize(firstFace[chunks], GraphicsContext::WHITE);
+
+    inParallel(parse);
+
+    // an "endfacet" in the name of a solid throws the counts off, so such a file
+    // is read again from the start
+    if(std::find(mismatched.begin(), mismatched.end(), 1) != mismatched.end()){
+        mesh.resize(firstFace[0], GraphicsContext::WHITE);
+        p = begin;
+        parseAll();
+    }
+}
+
+/**
+ * Private helper which reads the facets of a binary STL file into the mesh. The mesh
+ * is sized once for all of them, then each block of facets is decoded into a small
+ * buffer and set in its place.
+ * 
+ * Inputs:
+ *      data - the facets, just after the 84 byte header
+ *      facets - number of facets held in data
+ * Outputs:
+ *      none
+ */
+void Image::readBinarySTL(const char* data, unsigned int facets){
+    std::vector<float> corners(STL_BLOCK_FACETS * 9);
+    std::vector<float> normals(STL_BLOCK_FACETS * 3);
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    const unsigned int first = mesh.getFaceCount();
+
+    mesh.resize(first + facets, GraphicsContext::WHITE);
+
+    // each facet is a normal and three corners as 12 little-endian floats,
+    // followed by 2 attribute bytes which are ignored
+    for(unsigned int done = 0; done < facets; ){
+        const unsigned int count = std::min(facets - done, STL_BLOCK_FACETS);
+
+        for(unsigned int f = 0; f < count; f++){
+            const unsigned char* facet = bytes + (size_t)(done + f) * STL_FACET_SIZE;
+            for(int i = 0; i < 3; i++){
+                normals[f * 3 + i] = readLittleEndianFloat(facet + i * 4);
+            }
+            for(int i = 0; i < 9; i++){
+                corners[f * 9 + i] = readLittleEndianFloat(facet + 12 + i * 4);
+            }
+        }
+
+        mesh.setFaces(first + done, corners.data(), normals.data(), count);
+        done += count;
     }
-    return image;
 }
 
 /* 
@@ -195,6 +651,737 @@ void Image::erase(){
     }
 
     shapes.erase(shapes.begin(), shapes.end());
+    mesh.clear();
+    invalidateCache();
+}
+
+/* 
+ * Returns the triangle mesh holding the faces read from an STL file.
+ * 
+ * Parameters:
+ * 	none
+ * 
+ * Returns:
+ *   reference to the mesh
+ */
+const TriangleMesh& Image::getMesh() const{
+    return mesh;
+}
+
+/* 
+ * Chooses between drawing every edge of the mesh and drawing only its feature
+ * edges: creases sharper than the crease angle, boundaries and the silhouette.
+ * 
+ * Parameters:
+ * 	featureOnly - true to draw only feature edges
+ * 
+ * Returns:
+ *   void
+ */
+void Image::setFeatureEdges(bool featureOnly){
+    featureEdgesOnly = featureOnly;
+    visibleDirty = true;
+}
+
+/* 
+ * Returns true if only feature edges of the mesh are drawn.
+ */
+bool Image::getFeatureEdges() const{
+    return featureEdgesOnly;
+}
+
+/* 
+ * Sets the angle between face normals above which an edge counts as a crease.
+ * 
+ * Parameters:
+ * 	degrees - crease angle in degrees
+ * 
+ * Returns:
+ *   void
+ */
+void Image::setCreaseAngle(double degrees){
+    creaseAngle = degrees;
+    mesh.findFeatureEdges(creaseAngle);
+    visibleDirty = true;
+}
+
+/* 
+ * Turns back-face culling of the mesh on or off. When on, edges are only drawn if
+ * at least one of the faces using them points toward the eye, and verticies used
+ * only by culled faces are not transformed.
+ * 
+ * Parameters:
+ * 	cull - true to cull back faces
+ * 
+ * Returns:
+ *   void
+ */
+void Image::setBackFaceCulling(bool cull){
+    backFaceCulling = cull;
+    visibleDirty = true;
+}
+
+/* 
+ * Returns true if back faces of the mesh are culled.
+ */
+bool Image::getBackFaceCulling() const{
+    return backFaceCulling;
+}
+
+/* 
+ * Chooses between drawing the mesh as lines and drawing its faces filled, lit from
+ * the eye. Filled faces hide each other only on graphics contexts with a depth
+ * buffer; elsewhere their outlines are drawn.
+ * 
+ * Parameters:
+ * 	solid - true to fill the faces
+ * 
+ * Returns:
+ *   void
+ */
+void Image::setFilled(bool solid){
+    filled = solid;
+}
+
+/* 
+ * Returns true if the faces of the mesh are drawn filled.
+ */
+bool Image::getFilled() const{
+    return filled;
+}
+
+/* 
+ * Private helper which draws the mesh, as lines or filled faces.
+ * 
+ * Parameters:
+ * 	gc - pointer to a graphics context object.
+ *  vc - pointer to the view context.
+ * 
+ * Returns:
+ *   void
+ */
+void Image::drawMesh(GraphicsContext* gc, ViewContext* vc){
+    if(mesh.getFaceCount() == 0){
+        return;
+    }
+
+    if(filled){
+        drawFaces(gc, vc);
+        return;
+    }
+
+    const int width = gc->getWindowWidth();
+    const int height = gc->getWindowHeight();
+
+    // nothing to do at all when the whole mesh is out of view
+    if(!vc->boxVisible(mesh.getBounds(), width, height)){
+        return;
+    }
+
+    selectEdges(vc);
+
+    if(visibleColors.empty()){
+        return;
+    }
+
+    const unsigned int clusters = mesh.getClusterCount();
+    const float* clusterBounds = mesh.getClusterBounds();
+    const unsigned long revision = vc->getProjectionRevision();
+
+    // clusters entirely out of view are neither transformed nor drawn, so only
+    // the verticies of the rest are brought up to date
+    for(unsigned int c = 0; c < clusters; c++){
+        clusterVisible[c] = clusterEdgeStart[c] != clusterEdgeStart[c + 1] &&
+                            vc->boxVisible(clusterBounds + c * 6, width, height);
+        if(!clusterVisible[c]){
+            continue;
+        }
+
+        const unsigned int first = clusterVertexStart[c];
+        const unsigned int count = clusterVertexStart[c + 1] - first;
+
+        if(clusterRevision[c] != revision){
+            meshCache.projectRange(vc, visibleX.data(), visibleY.data(), visibleZ.data(), first, count);
+            clusterRevision[c] = revision;
+        }
+        meshCache.toDevice(vc, first, count);
+    }
+
+    // a vertex shared with a cluster out of view was skipped above
+    strayVerticies.clear();
+    for(unsigned int c = 0; c < clusters; c++){
+        if(!clusterVisible[c]){
+            continue;
+        }
+        for(unsigned int i = clusterSharedStart[c]; i < clusterSharedStart[c + 1]; i++){
+            if(!clusterVisible[vertexCluster[sharedVerticies[i]]]){
+                strayVerticies.push_back(sharedVerticies[i]);
+            }
+        }
+    }
+
+    if(!strayVerticies.empty()){
+        std::sort(strayVerticies.begin(), strayVerticies.end());
+        strayVerticies.erase(std::unique(strayVerticies.begin(), strayVerticies.end()), strayVerticies.end());
+        meshCache.projectScattered(vc, visibleX.data(), visibleY.data(), visibleZ.data(),
+                                   strayVerticies.data(), strayVerticies.size());
+    }
+
+    const float* clipX = meshCache.clipX.data();
+    const float* clipY = meshCache.clipY.data();
+    const float* clipW = meshCache.clipW.data();
+    const float* deviceX = meshCache.deviceX.data();
+    const float* deviceY = meshCache.deviceY.data();
+
+    segments.clear();
+    segmentColors.clear();
+
+    for(unsigned int c = 0; c < clusters; c++){
+        if(!clusterVisible[c]){
+            continue;
+        }
+
+        for(unsigned int e = clusterEdgeStart[c]; e < clusterEdgeStart[c + 1]; e++){
+            const unsigned int a = visibleEdges[e * 2];
+            const unsigned int b = visibleEdges[e * 2 + 1];
+
+            GraphicsContext::Segment segment;
+
+            if(clipW[a] >= ViewContext::NEAR_PLANE && clipW[b] >= ViewContext::NEAR_PLANE){
+                if(!GraphicsContext::toSegment(deviceX[a], deviceY[a], deviceX[b], deviceY[b], segment)){
+                    continue;
+                }
+            }else{
+                // crosses the near plane, or lies wholly behind it
+                float x[2] = {clipX[a], clipX[b]};
+                float y[2] = {clipY[a], clipY[b]};
+                float w[2] = {clipW[a], clipW[b]};
+                if(!ViewContext::clipToNearPlane(x, y, w)){
+                    continue;
+                }
+
+                float clippedX[2], clippedY[2];
+                vc->clipToDevice(x, y, w, 2, clippedX, clippedY);
+                if(!GraphicsContext::toSegment(clippedX[0], clippedY[0], clippedX[1], clippedY[1], segment)){
+                    continue;
+                }
+            }
+
+            segments.push_back(segment);
+            segmentColors.push_back(visibleColors[e]);
+        }
+    }
+
+    // one call for each run of edges sharing a color
+    const unsigned int count = segments.size();
+    for(unsigned int first = 0; first < count; ){
+        unsigned int last = first + 1;
+        while(last < count && segmentColors[last] == segmentColors[first]){
+            last++;
+        }
+
+        gc->setColor(segmentColors[first]);
+        gc->drawLines(&segments[first], last - first);
+        first = last;
+    }
+}
+
+/* 
+ * Private helper which draws the faces of the mesh filled, nearest first where
+ * the graphics context has a depth buffer.
+ * 
+ * Parameters:
+ * 	gc - pointer to a graphics context object.
+ *  vc - pointer to the view context.
+ * 
+ * Returns:
+ *   void
+ */
+void Image::drawFaces(GraphicsContext* gc, ViewContext* vc){
+    const int width = gc->getWindowWidth();
+    const int height = gc->getWindowHeight();
+
+    if(!vc->boxVisible(mesh.getBounds(), width, height)){
+        return;
+    }
+
+    if(backFaceCulling){
+        updateFacing(vc);
+    }
+    updateShading(vc);
+
+    const unsigned int vertexCount = mesh.getVertexCount();
+    faceCache.project(vc, mesh.getX(), mesh.getY(), mesh.getZ(), vertexCount);
+    faceCache.toDevice(vc, 0, vertexCount);
+
+    const float* clipX = faceCache.clipX.data();
+    const float* clipY = faceCache.clipY.data();
+    const float* clipW = faceCache.clipW.data();
+    const float* deviceX = faceCache.deviceX.data();
+    const float* deviceY = faceCache.deviceY.data();
+    const unsigned int* indices = mesh.getIndices();
+    const float* clusterBounds = mesh.getClusterBounds();
+    const unsigned int faces = mesh.getFaceCount();
+
+    for(unsigned int c = 0; c < mesh.getClusterCount(); c++){
+        if(!vc->boxVisible(clusterBounds + c * 6, width, height)){
+            continue;
+        }
+
+        const unsigned int last = std::min(faces, (c + 1) * TriangleMesh::CLUSTER_SIZE);
+        for(unsigned int f = c * TriangleMesh::CLUSTER_SIZE; f < last; f++){
+            if(backFaceCulling && !frontFacing[f]){
+                continue;
+            }
+
+            const unsigned int* v = &indices[f * 3];
+            gc->setColor(shadedColors[f]);
+
+            // the depth buffer holds 1 / w, which unlike w itself varies
+            // linearly across the screen
+            if(clipW[v[0]] >= ViewContext::NEAR_PLANE && clipW[v[1]] >= ViewContext::NEAR_PLANE &&
+               clipW[v[2]] >= ViewContext::NEAR_PLANE){
+                const float x[3] = {deviceX[v[0]], deviceX[v[1]], deviceX[v[2]]};
+                const float y[3] = {deviceY[v[0]], deviceY[v[1]], deviceY[v[2]]};
+                const float depth[3] = {1.0f / clipW[v[0]], 1.0f / clipW[v[1]], 1.0f / clipW[v[2]]};
+                gc->fillTriangle(x, y, depth);
+                continue;
+            }
+
+            // crosses the near plane: fill what is in front of it as a fan
+            const float x[3] = {clipX[v[0]], clipX[v[1]], clipX[v[2]]};
+            const float y[3] = {clipY[v[0]], clipY[v[1]], clipY[v[2]]};
+            const float w[3] = {clipW[v[0]], clipW[v[1]], clipW[v[2]]};
+            float polygonX[4], polygonY[4], polygonW[4];
+            float polygonDeviceX[4], polygonDeviceY[4], polygonDepth[4];
+
+            const unsigned int corners = ViewContext::clipToNearPlane(x, y, w, 3, polygonX, polygonY, polygonW);
+            vc->clipToDevice(polygonX, polygonY, polygonW, corners, polygonDeviceX, polygonDeviceY);
+
+            for(unsigned int i = 0; i < corners; i++){
+                polygonDepth[i] = 1.0f / polygonW[i];
+            }
+
+            for(unsigned int i = 1; i + 1 < corners; i++){
+                const float fanX[3] = {polygonDeviceX[0], polygonDeviceX[i], polygonDeviceX[i + 1]};
+                const float fanY[3] = {polygonDeviceY[0], polygonDeviceY[i], polygonDeviceY[i + 1]};
+                const float fanDepth[3] = {polygonDepth[0], polygonDepth[i], polygonDepth[i + 1]};
+                gc->fillTriangle(fanX, fanY, fanDepth);
+            }
+        }
+    }
+}
+
+/* 
+ * Private helper which brings the shaded face colors up to date for the current
+ * eye position.
+ * 
+ * Parameters:
+ *  vc - pointer to the view context.
+ * 
+ * Returns:
+ *   void
+ */
+void Image::updateShading(ViewContext* vc){
+    const unsigned int faces = mesh.getFaceCount();
+
+    if(shadedColors.size() == faces && shadingRevision == vc->getProjectionRevision()){
+        return;
+    }
+
+    shadedColors.resize(faces);
+    shadingRevision = vc->getProjectionRevision();
+
+    const unsigned int* colors = mesh.getColors();
+    const float* normalX = mesh.getNormalX();
+    const float* normalY = mesh.getNormalY();
+    const float* normalZ = mesh.getNormalZ();
+
+    // lit by a distant light behind the eye, shining toward the middle of the
+    // mesh, so that faces in one plane are shaded alike and those turned square
+    // to the eye are brightest
+    const Vec3 eye = vc->getEyePosition();
+    const float* bounds = mesh.getBounds();
+    double lightX = eye[0][0] - (bounds[0] + bounds[3]) / 2.0;
+    double lightY = eye[1][0] - (bounds[1] + bounds[4]) / 2.0;
+    double lightZ = eye[2][0] - (bounds[2] + bounds[5]) / 2.0;
+    const double distance = std::sqrt(lightX * lightX + lightY * lightY + lightZ * lightZ);
+    if(distance > 0){
+        lightX /= distance;     lightY /= distance;     lightZ /= distance;
+    }
+
+    for(unsigned int f = 0; f < faces; f++){
+        const double facing = std::abs(normalX[f] * lightX + normalY[f] * lightY + normalZ[f] * lightZ);
+        const double light = AMBIENT_LIGHT + (1 - AMBIENT_LIGHT) * std::min(facing, 1.0);
+
+        const unsigned int red = ((colors[f] >> 16) & 0xFF) * light;
+        const unsigned int green = ((colors[f] >> 8) & 0xFF) * light;
+        const unsigned int blue = (colors[f] & 0xFF) * light;
+        shadedColors[f] = (red << 16) | (green << 8) | blue;
+    }
+}
+
+/* 
+ * Private helper which brings the per-face front facing flags up to date for
+ * the current eye position.
+ * 
+ * Parameters:
+ *  vc - pointer to the view context.
+ * 
+ * Returns:
+ *   void
+ */
+void Image::updateFacing(ViewContext* vc){
+    const unsigned int faces = mesh.getFaceCount();
+
+    if(frontFacing.size() == faces && facingRevision == vc->getProjectionRevision()){
+        return;
+    }
+
+    frontFacing.resize(faces);
+    facingRevision = vc->getProjectionRevision();
+
+    const Vec3 eye = vc->getEyePosition();
+    const float* x = mesh.getX();
+    const float* y = mesh.getY();
+    const float* z = mesh.getZ();
+    const unsigned int* indices = mesh.getIndices();
+    const float* normalX = mesh.getNormalX();
+    const float* normalY = mesh.getNormalY();
+    const float* normalZ = mesh.getNormalZ();
+
+    for(unsigned int f = 0; f < faces; f++){
+        const unsigned int v = indices[f * 3];
+        const double toEye = normalX[f] * (eye[0][0] - x[v]) + normalY[f] * (eye[1][0] - y[v]) +
+                             normalZ[f] * (eye[2][0] - z[v]);
+        frontFacing[f] = toEye > 0;
+    }
+}
+
+/* 
+ * Private helper which chooses the mesh edges to draw for the current view and
+ * drawing mode, and gathers the verticies they use.
+ * 
+ * Parameters:
+ *  vc - pointer to the view context.
+ * 
+ * Returns:
+ *   void
+ */
+void Image::selectEdges(ViewContext* vc){
+    const bool viewDependent = featureEdgesOnly || backFaceCulling;
+
+    if(!visibleDirty && (!viewDependent || visibleRevision == vc->getProjectionRevision())){
+        return;
+    }
+
+    if(viewDependent){
+        updateFacing(vc);
+    }
+
+    const float* x = mesh.getX();
+    const float* y = mesh.getY();
+    const float* z = mesh.getZ();
+    const unsigned int* edges = mesh.getEdges();
+    const unsigned int* edgeFaces = mesh.getEdgeFaces();
+    const unsigned int* colors = mesh.getColors();
+    const unsigned char* featureFlags = mesh.getFeatureFlags();
+    const unsigned int edgeCount = mesh.getEdgeCount();
+    const unsigned int clusters = mesh.getClusterCount();
+
+    compactIndex.assign(mesh.getVertexCount(), NO_VERTEX);
+    visibleEdges.clear();
+    visibleColors.clear();
+    visibleX.clear();
+    visibleY.clear();
+    visibleZ.clear();
+    vertexCluster.clear();
+    sharedVerticies.clear();
+    clusterEdgeStart.assign(clusters + 1, 0);
+    clusterVertexStart.assign(clusters + 1, 0);
+    clusterSharedStart.assign(clusters + 1, 0);
+
+    // edges come grouped by the cluster of their first face, and the selected ones
+    // are laid out the same way, with each vertex stored once in the first cluster
+    // using it, so that a cluster out of view can be skipped entirely
+    unsigned int cluster = 0;
+
+    // moves on to the next cluster, listing the shared verticies of the last once each
+    auto nextCluster = [&](){
+        std::sort(sharedVerticies.begin() + clusterSharedStart[cluster], sharedVerticies.end());
+        sharedVerticies.erase(std::unique(sharedVerticies.begin() + clusterSharedStart[cluster],
+                                          sharedVerticies.end()), sharedVerticies.end());
+        cluster++;
+        clusterEdgeStart[cluster] = visibleColors.size();
+        clusterVertexStart[cluster] = visibleX.size();
+        clusterSharedStart[cluster] = sharedVerticies.size();
+    };
+
+    for(unsigned int e = 0; e < edgeCount; e++){
+        const unsigned int f0 = edgeFaces[e * 2];
+        const unsigned int f1 = edgeFaces[e * 2 + 1];
+
+        // in feature mode creases and boundaries are fixed at load time, and of the
+        // remaining smooth edges only the silhouette - between a face turned toward
+        // the eye and one turned away - is drawn
+        if(featureEdgesOnly && !featureFlags[e] && frontFacing[f0] == frontFacing[f1]){
+            continue;
+        }
+
+        // an edge is hidden only when every face using it is turned away
+        if(backFaceCulling && !frontFacing[f0] && (f1 == TriangleMesh::NO_FACE || !frontFacing[f1])){
+            continue;
+        }
+
+        while(cluster < f0 / TriangleMesh::CLUSTER_SIZE){
+            nextCluster();
+        }
+
+        for(int end = 0; end < 2; end++){
+            const unsigned int v = edges[e * 2 + end];
+            if(compactIndex[v] == NO_VERTEX){
+                compactIndex[v] = visibleX.size();
+                visibleX.push_back(x[v]);
+                visibleY.push_back(y[v]);
+                visibleZ.push_back(z[v]);
+                vertexCluster.push_back(cluster);
+            }else if(compactIndex[v] < clusterVertexStart[cluster]){
+                sharedVerticies.push_back(compactIndex[v]);
+            }
+            visibleEdges.push_back(compactIndex[v]);
+        }
+
+        // drawn in the color of the first face using the edge
+        visibleColors.push_back(colors[f0]);
+    }
+
+    while(cluster < clusters){
+        nextCluster();
+    }
+
+    // nothing is projected until its cluster comes into view
+    meshCache.resize(visibleX.size());
+    clusterRevision.assign(clusters, 0);
+    clusterVisible.assign(clusters, 0);
+
+    visibleRevision = vc->getProjectionRevision();
+    visibleDirty = false;
+}
+
+/* 
+ * Private helper which draws the individual shapes.
+ * 
+ * Parameters:
+ * 	gc - pointer to a graphics context object.
+ *  vc - pointer to the view context.
+ * 
+ * Returns:
+ *   void
+ */
+void Image::drawShapes(GraphicsContext* gc, ViewContext* vc){
+    if(!modelCached){
+        gatherModelCoordinates();
+    }
+
+    shapeCache.project(vc, modelX.data(), modelY.data(), modelZ.data(), modelX.size());
+
+    unsigned int first = 0;
+    for(std::vector<Shape*>::const_iterator iter(shapes.begin()); iter != shapes.end(); ++iter){
+        (*iter)->drawClip(gc, vc, shapeCache.clipX.data() + first, shapeCache.clipY.data() + first,
+                          shapeCache.clipW.data() + first);
+        first += (*iter)->vertexCount();
+    }
+}
+
+/* 
+ * Private helper which gathers the model coordinates of every shape into the
+ * structure-of-arrays cache.
+ * 
+ * Parameters:
+ * 	none
+ * 
+ * Returns:
+ *   void
+ */
+void Image::gatherModelCoordinates(){
+    unsigned int n = 0;
+    for(std::vector<Shape*>::const_iterator iter(shapes.begin()); iter != shapes.end(); ++iter){
+        n += (*iter)->vertexCount();
+    }
+
+    modelX.resize(n);
+    modelY.resize(n);
+    modelZ.resize(n);
+
+    unsigned int first = 0;
+    for(std::vector<Shape*>::const_iterator iter(shapes.begin()); iter != shapes.end(); ++iter){
+        (*iter)->getModelCoordinates(modelX.data() + first, modelY.data() + first, modelZ.data() + first);
+        first += (*iter)->vertexCount();
+    }
+
+    modelCached = true;
+    shapeCache.invalidate();
+}
+
+/* 
+ * Private helper which discards the cached coordinates. Must be called whenever
+ * the shapes in the image change.
+ * 
+ * Parameters:
+ * 	none
+ * 
+ * Returns:
+ *   void
+ */
+void Image::invalidateCache(){
+    modelCached = false;
+    shapeCache.invalidate();
+    meshCache.invalidate();
+    faceCache.invalidate();
+    facingRevision = 0;
+    shadingRevision = 0;
+    visibleDirty = true;
+}
+
+/* 
+ * This is a default constructor for an empty ProjectionCache.
+ * 
+ * Parameters:
+ * 	none
+ */
+Image::ProjectionCache::ProjectionCache(){
+    revision = 0;
+}
+
+/* 
+ * Brings the homogeneous coordinates up to date for the current view, leaving the
+ * device coordinates to toDevice.
+ * 
+ * Parameters:
+ * 	vc - pointer to the ViewContext
+ *  x, y, z - model coordinates, n entries each
+ *  n - number of verticies
+ * 
+ * Returns:
+ *  void
+ */
+void Image::ProjectionCache::project(ViewContext* vc, const float* x, const float* y, const float* z, unsigned int n){
+    if(clipX.size() != n){
+        clipX.resize(n);        clipY.resize(n);        clipW.resize(n);
+        deviceX.resize(n);      deviceY.resize(n);
+        revision = 0;
+    }
+
+    // pan, zoom and rotate leave the projection untouched - only redo it when
+    // the orbit or FOV has changed since it was cached
+    if(revision != vc->getProjectionRevision()){
+        vc->modelToClip(x, y, z, n, clipX.data(), clipY.data(), clipW.data());
+        revision = vc->getProjectionRevision();
+    }
+}
+
+/* 
+ * Recomputes the device coordinates of a range of verticies from their homogeneous
+ * coordinates. Verticies behind the near plane get meaningless device coordinates.
+ * 
+ * Parameters:
+ * 	vc - pointer to the ViewContext
+ *  first - first vertex of the range
+ *  count - number of verticies in the range
+ * 
+ * Returns:
+ *  void
+ */
+void Image::ProjectionCache::toDevice(ViewContext* vc, unsigned int first, unsigned int count){
+    vc->clipToDevice(clipX.data() + first, clipY.data() + first, clipW.data() + first, count,
+                     deviceX.data() + first, deviceY.data() + first);
+}
+
+/* 
+ * Sizes the cache for a vertex set without projecting anything, for callers
+ * which project it a range at a time with projectRange.
+ * 
+ * Parameters:
+ * 	n - number of verticies
+ * 
+ * Returns:
+ *  void
+ */
+void Image::ProjectionCache::resize(unsigned int n){
+    clipX.resize(n);        clipY.resize(n);        clipW.resize(n);
+    deviceX.resize(n);      deviceY.resize(n);
+    revision = 0;
+}
+
+/* 
+ * Recomputes the homogeneous coordinates of a range of verticies, whatever the
+ * revision they were last computed for.
+ * 
+ * Parameters:
+ * 	vc - pointer to the ViewContext
+ *  x, y, z - model coordinates of the whole vertex set
+ *  first - first vertex of the range
+ *  count - number of verticies in the range
+ * 
+ * Returns:
+ *  void
+ */
+void Image::ProjectionCache::projectRange(ViewContext* vc, const float* x, const float* y, const float* z,
+                                          unsigned int first, unsigned int count){
+    vc->modelToClip(x + first, y + first, z + first, count,
+                    clipX.data() + first, clipY.data() + first, clipW.data() + first);
+}
+
+/* 
+ * Recomputes both the homogeneous and device coordinates of scattered verticies,
+ * gathering them so they are still transformed as one batch.
+ * 
+ * Parameters:
+ * 	vc - pointer to the ViewContext
+ *  x, y, z - model coordinates of the whole vertex set
+ *  which - indices of the verticies to recompute
+ *  n - number of indices
+ * 
+ * Returns:
+ *  void
+ */
+void Image::ProjectionCache::projectScattered(ViewContext* vc, const float* x, const float* y, const float* z,
+                                              const unsigned int* which, unsigned int n){
+    gatherX.resize(n);          gatherY.resize(n);          gatherZ.resize(n);
+    gatherClipX.resize(n);      gatherClipY.resize(n);      gatherClipW.resize(n);
+    gatherDeviceX.resize(n);    gatherDeviceY.resize(n);
+
+    for(unsigned int i = 0; i < n; i++){
+        gatherX[i] = x[which[i]];
+        gatherY[i] = y[which[i]];
+        gatherZ[i] = z[which[i]];
+    }
+
+    vc->modelToClip(gatherX.data(), gatherY.data(), gatherZ.data(), n,
+                    gatherClipX.data(), gatherClipY.data(), gatherClipW.data());
+    vc->clipToDevice(gatherClipX.data(), gatherClipY.data(), gatherClipW.data(), n,
+                     gatherDeviceX.data(), gatherDeviceY.data());
+
+    for(unsigned int i = 0; i < n; i++){
+        clipX[which[i]] = gatherClipX[i];
+        clipY[which[i]] = gatherClipY[i];
+        clipW[which[i]] = gatherClipW[i];
+        deviceX[which[i]] = gatherDeviceX[i];
+        deviceY[which[i]] = gatherDeviceY[i];
+    }
+}
+
+/* 
+ * Discards the cached projection.
+ * 
+ * Parameters:
+ * 	none
+ * 
+ * Returns:
+ *  void
+ */
+void Image::ProjectionCache::invalidate(){
+    revision = 0;
 }
 
 
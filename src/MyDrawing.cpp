@@ -45,7 +45,6 @@ MyDrawing::~MyDrawing(){
  *      none
  */
 void MyDrawing::paint(GraphicsContext* gc){
-    gc->clear();
     image->draw(gc,vc);
 }
 
@@ -178,6 +177,18 @@ void MyDrawing::keyDown(GraphicsContext* gc, unsigned int keycode){
             vc->adjustFOV(-10);
             image->draw(gc,vc);
             break;
+        case 'e':
+            image->setFeatureEdges(!image->getFeatureEdges());
+            image->draw(gc,vc);
+            break;
+        case 'b':
+            image->setBackFaceCulling(!image->getBackFaceCulling());
+            image->draw(gc,vc);
+            break;
+        case 's':
+            image->setFilled(!image->getFilled());
+            image->draw(gc,vc);
+            break;
         default:
             printHelp();
     }
@@ -207,21 +218,19 @@ void MyDrawing::saveToFile(){
  *      none
  */
 void MyDrawing::loadFromFile(){
-    std::ifstream myfile;
     std::string file = "./resources/cube.stl";
-    myfile.open(file);
 
     if(file.substr(file.size()-3).compare("stl")==0){
-        image = Image::readSTLFile(myfile);
+        image = Image::readSTLFile(file);
 
         //add axis
         image->add(new Triangle(0,0,0,100,0,0,0,0,0,124,252,0));
         image->add(new Triangle(0,0,0,0,100,0,0,0,0,255,20,147));
         image->add(new Triangle(0,0,0,0,0,100,0,0,0,0,0,255));
     }else if(file.substr(file.size()-3).compare(".txt")==0){
+        std::ifstream myfile(file);
         image = Image::in(myfile);
     }
-    myfile.close();
 }
 
 /* 
@@ -245,5 +254,9 @@ void MyDrawing::printHelp(){
                  "\t\t\tDrag left - rotate clockwise around y axis\n"
                  "\t\t\tDrag right - rotate counter clockwise around y axis\n"
                  "\t\t\tDrag up - vertical orbit up\tDrag down - vertical orbit down\n"
-                 "\t\tz - increase FOV\tx - decrease FOV\n" << std::endl;
+                 "\t\tz - increase FOV\tx - decrease FOV\n"
+                 "\tDisplay:\n"
+                 "\t\te - toggle between all edges and feature edges only\n"
+                 "\t\tb - toggle back-face culling\n"
+                 "\t\ts - toggle between lines and filled faces\n" << std::endl;
 }
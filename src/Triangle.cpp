@@ -112,13 +112,80 @@ Triangle::~Triangle(){}
  *  none
  */
 void Triangle::draw(GraphicsContext* gc, ViewContext* vc){
-    gc->setColor(color->color);
-    matrix* deviceCoord = vc->modelToDevice(this->verticies);
+    float x[3], y[3], z[3];
+    float clipX[3], clipY[3], clipW[3];
+
+    getModelCoordinates(x, y, z);
+    vc->modelToClip(x, y, z, 3, clipX, clipY, clipW);
+    drawClip(gc, vc, clipX, clipY, clipW);
+}
 
-    gc->drawLine((*deviceCoord)[0][0], (*deviceCoord)[1][0], (*deviceCoord)[0][1], (*deviceCoord)[1][1]);
-    gc->drawLine((*deviceCoord)[0][1], (*deviceCoord)[1][1], (*deviceCoord)[0][2], (*deviceCoord)[1][2]);
-    gc->drawLine((*deviceCoord)[0][2], (*deviceCoord)[1][2], (*deviceCoord)[0][0], (*deviceCoord)[1][0]);
-    delete deviceCoord;
+/* 
+ * Returns the number of verticies that make up the Triangle, which is always 3.
+ * 
+ * Parameters:
+ * 	none
+ * 
+ * Returns:
+ *  number of verticies
+ */
+unsigned int Triangle::vertexCount() const{
+    return 3;
+}
+
+/* 
+ * Copies the model coordinates of the Triangle verticies into structure-of-arrays buffers.
+ * 
+ * Parameters:
+ * 	x, y, z - arrays of at least 3 entries receiving the coordinates
+ * 
+ * Returns:
+ *  void
+ */
+void Triangle::getModelCoordinates(float* x, float* y, float* z) const{
+    for(int i = 0; i < 3; i++){
+        x[i] = (*verticies)[0][i];
+        y[i] = (*verticies)[1][i];
+        z[i] = (*verticies)[2][i];
+    }
+}
+
+/* 
+ * Draws the Triangle outline from precomputed homogeneous coordinates, clipping each
+ * edge against the near plane.
+ * 
+ * Parameters:
+ * 	gc - pointer to graphics context object
+ *  vc - pointer to the view context
+ *  clipX, clipY, clipW - homogeneous coordinates of the 3 verticies
+ * 
+ * Returns:
+ *  void
+ */
+void Triangle::drawClip(GraphicsContext* gc, const ViewContext* vc, const float* clipX,
+                        const float* clipY, const float* clipW) const{
+    GraphicsContext::Segment edges[3];
+    unsigned int count = 0;
+
+    for(int i = 0; i < 3; i++){
+        float x[2] = {clipX[i], clipX[(i + 1) % 3]};
+        float y[2] = {clipY[i], clipY[(i + 1) % 3]};
+        float w[2] = {clipW[i], clipW[(i + 1) % 3]};
+
+        if(!ViewContext::clipToNearPlane(x, y, w)){
+            continue;
+        }
+
+        float deviceX[2], deviceY[2];
+        vc->clipToDevice(x, y, w, 2, deviceX, deviceY);
+
+        if(GraphicsContext::toSegment(deviceX[0], deviceY[0], deviceX[1], deviceY[1], edges[count])){
+            count++;
+        }
+    }
+
+    gc->setColor(color->color);
+    gc->drawLines(edges, count);
 }
 
 /* 
@@ -156,7 +223,7 @@ std::ostream& Triangle::out(std::ostream& os) const{
  */
 Triangle* Triangle::in(std::istream& iStream){
     std::string v1, v2, v3;
-    Triangle * triangleObj;
+    Triangle * triangleObj = nullptr;
     while(!iStream.eof()){
         std::string line;
 
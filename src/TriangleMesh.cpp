@@ -0,0 +1,913 @@
+/**
+ * TriangleMesh.cpp - This is an implementation of the TriangleMesh class
+ */
+
+#include "TriangleMesh.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define PI 3.14159265359
+
+const unsigned int TriangleMesh::NO_FACE;
+const unsigned int TriangleMesh::CLUSTER_SIZE;
+
+/*
+ * Private helper returning the bit pattern of a coordinate for hashing and comparison,
+ * with -0.0 folded into 0.0 so that the two weld together.
+ */
+static inline uint32_t coordinateBits(float value){
+    uint32_t bits;
+    if(value == 0.0f){
+        value = 0.0f;
+    }
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// layout of the files written by save(): a header followed by each array in its
+// own section, starting on a MESH_FILE_ALIGNMENT byte boundary. Numbers are in
+// the byte order of the machine writing the file, so sections are used as mapped.
+static const char MESH_FILE_MAGIC[8] = {'S', 'T', 'L', 'M', 'E', 'S', 'H', '\0'};
+static const uint32_t MESH_FILE_VERSION = 1;
+static const uint32_t MESH_FILE_BYTE_ORDER = 0x01020304;
+static const uint64_t MESH_FILE_ALIGNMENT = 64;
+
+enum MeshFileSection{SECTION_X, SECTION_Y, SECTION_Z, SECTION_INDICES, SECTION_COLORS,
+                     SECTION_NORMAL_X, SECTION_NORMAL_Y, SECTION_NORMAL_Z, SECTION_EDGES,
+                     SECTION_EDGE_FACES, SECTION_FEATURE_FLAGS, SECTION_CLUSTER_BOUNDS,
+                     SECTION_COUNT};
+
+struct MeshFileHeader{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    double featureAngle;
+    float bounds[6];
+    uint32_t vertexCount;
+    uint32_t faceCount;
+    uint32_t edgeCount;
+    uint32_t normals;
+    uint64_t offset[SECTION_COUNT];
+    uint64_t size[SECTION_COUNT];
+};
+
+/*
+ * Private helper giving the number of bytes each section of a mesh file should hold
+ * for the counts in its header.
+ */
+static void sectionSizes(const MeshFileHeader& header, uint64_t* size){
+    const uint64_t vertices = header.vertexCount;
+    const uint64_t faces = header.faceCount;
+    const uint64_t edges = header.edgeCount;
+    const uint64_t normals = header.normals ? faces : 0;
+    const uint64_t clusters = (faces + TriangleMesh::CLUSTER_SIZE - 1) / TriangleMesh::CLUSTER_SIZE;
+
+    size[SECTION_X] = size[SECTION_Y] = size[SECTION_Z] = vertices * sizeof(float);
+    size[SECTION_INDICES] = faces * 3 * sizeof(unsigned int);
+    size[SECTION_COLORS] = faces * sizeof(unsigned int);
+    size[SECTION_NORMAL_X] = size[SECTION_NORMAL_Y] = size[SECTION_NORMAL_Z] = normals * sizeof(float);
+    size[SECTION_EDGES] = size[SECTION_EDGE_FACES] = edges * 2 * sizeof(unsigned int);
+    size[SECTION_FEATURE_FLAGS] = edges;
+    size[SECTION_CLUSTER_BOUNDS] = clusters * 6 * sizeof(float);
+}
+
+/*
+ * Private helper rounding a file offset up to the start of the next section.
+ */
+static inline uint64_t alignSection(uint64_t offset){
+    return (offset + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+}
+
+/*
+ * Private helper writing all of a buffer to a file descriptor, however many calls
+ * it takes.
+ */
+static bool writeAll(int fd, const void* data, size_t size){
+    const char* p = static_cast<const char*>(data);
+    while(size > 0){
+        const ssize_t written = write(fd, p, size);
+        if(written < 0 && errno == EINTR){
+            continue;
+        }
+        if(written <= 0){
+            return false;
+        }
+        p += written;
+        size -= written;
+    }
+    return true;
+}
+
+/*
+ * Private helper checking that every index in a mapped section is below limit, so
+ * that a damaged file can not send a lookup out of an array.
+ */
+static bool indicesBelow(const unsigned int* p, uint64_t count, uint64_t limit){
+    for(uint64_t i = 0; i < count; i++){
+        if(p[i] >= limit){
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * This is a default constructor for an empty TriangleMesh.
+ *
+ * Parameters:
+ * 	none
+ */
+TriangleMesh::TriangleMesh(){
+    for(int i = 0; i < 6; i++){
+        bounds[i] = 0;
+    }
+    featureAngle = 0;
+}
+
+/*
+ * Appends a face to the mesh. Each call adds three new verticies; call weld() once
+ * all faces are added to merge the duplicates.
+ *
+ * Parameters:
+ * 	x, y, z - model coordinates of the 3 corners of the face
+ *  color - 24-bit RGB color of the face
+ *
+ * Returns:
+ *  void
+ */
+void TriangleMesh::addFace(const float* x, const float* y, const float* z, unsigned int color){
+    detach();
+    for(int i = 0; i < 3; i++){
+        indices.push_back(this->x.size());
+        this->x.push_back(x[i]);
+        this->y.push_back(y[i]);
+        this->z.push_back(z[i]);
+    }
+    colors.push_back(color);
+}
+
+/*
+ * Appends a face with a known normal to the mesh. Normals are optional, but once
+ * any face has one every face is expected to.
+ *
+ * Parameters:
+ * 	x, y, z - model coordinates of the 3 corners of the face
+ *  color - 24-bit RGB color of the face
+ *  nx, ny, nz - face normal
+ *
+ * Returns:
+ *  void
+ */
+void TriangleMesh::addFace(const float* x, const float* y, const float* z, unsigned int color,
+                           float nx, float ny, float nz){
+    addFace(x, y, z, color);
+    normalX.push_back(nx);
+    normalY.push_back(ny);
+    normalZ.push_back(nz);
+}
+
+/*
+ * Appends a block of faces with known normals to the mesh, growing the arrays once
+ * for the whole block rather than a face at a time.
+ *
+ * Parameters:
+ * 	corners - model coordinates, 9 per face: x, y and z of each corner in turn
+ *  normals - face normals, 3 per face
+ *  count - number of faces
+ *  color - 24-bit RGB color of every face
+ *
+ * Returns:
+ *  void
+ */
+void TriangleMesh::addFaces(const float* corners, const float* normals, unsigned int count, unsigned int color){
+    const unsigned int first = getFaceCount();
+    resize(first + count, color);
+    setFaces(first, corners, normals, count);
+}
+
+/*
+ * Sets the number of faces in the mesh. New faces get three verticies of their own,
+ * the given color and zero normals, to be filled in with setFaces().
+ *
+ * Parameters:
+ * 	faces - number of faces the mesh is to hold
+ *  color - 24-bit RGB color of the new faces
+ *
+ * Returns:
+ *  void
+ */
+void TriangleMesh::resize(unsigned int faces, unsigned int color){
+    detach();
+    const unsigned int firstVertex = x.size();
+
+    x.resize(faces * 3);
+    y.resize(faces * 3);
+    z.resize(faces * 3);
+    indices.resize(faces * 3);
+    colors.resize(faces, color);
+    normalX.resize(faces);
+    normalY.resize(faces);
+    normalZ.resize(faces);
+
+    for(unsigned int v = firstVertex; v < faces * 3; v++){
+        indices[v] = v;
+    }
+}
+
+/*
+ * Overwrites the corners and normals of a range of faces added by addFaces() or
+ * resize() and not yet welded. Threads may fill separate ranges at the same time,
+ * so unlike the other changes this does not copy a mapped mesh out of its file -
+ * resize() and addFaces() already have, and nothing may map one in meanwhile.
+ *
+ * Parameters:
+ * 	first - index of the first face to set
+ *  corners - model coordinates, 9 per face: x, y and z of each corner in turn
+ *  normals - face normals, 3 per face
+ *  count - number of faces
+ *
+ * Returns:
+ *  void
+ */
+void TriangleMesh::setFaces(unsigned int first, const float* corners, const float* normals, unsigned int count){
+    for(unsigned int v = 0; v < count * 3; v++){
+        x[first * 3 + v] = corners[v * 3];
+        y[first * 3 + v] = corners[v * 3 + 1];
+        z[first * 3 + v] = corners[v * 3 + 2];
+    }
+
+    for(unsigned int f = 0; f < count; f++){
+        normalX[first + f] = normals[f * 3];
+        normalY[first + f] = normals[f * 3 + 1];
+        normalZ[first + f] = normals[f * 3 + 2];
+    }
+}
+
+/*
+ * Reserves storage for a number of faces, avoiding reallocation while a model
+ * of known size is read.
+ *
+ * Parameters:
+ * 	faces - number of faces to reserve space for
+ *
+ * Returns:
+ *  void
+ */
+void TriangleMesh::reserve(unsigned int faces){
+    detach();
+    x.reserve(faces * 3);
+    y.reserve(faces * 3);
+    z.reserve(faces * 3);
+    indices.reserve(faces * 3);
+    colors.reserve(faces);
+}
+
+/*
+ * Merges verticies with identical coordinates into one and rewrites the index buffer
+ * to match. STL files repeat every shared vertex in each facet using it, so on closed
+ * meshes this typically leaves one vertex for every two faces.
+ *
+ * Parameters:
+ * 	none
+ *
+ * Returns:
+ *  void
+ */
+void TriangleMesh::weld(){
+    detach();
+    const unsigned int n = x.size();
+    const unsigned int EMPTY = 0xFFFFFFFF;
+
+    // open addressing table of unique vertex indices, kept at most half full
+    unsigned int capacity = 16;
+    while(capacity < n * 2){
+        capacity <<= 1;
+    }
+    const unsigned int mask = capacity - 1;
+
+    std::vector<unsigned int> table(capacity, EMPTY);
+    std::vector<unsigned int> remap(n);
+    unsigned int unique = 0;
+
+    for(unsigned int i = 0; i < n; i++){
+        const uint32_t bx = coordinateBits(x[i]);
+        const uint32_t by = coordinateBits(y[i]);
+        const uint32_t bz = coordinateBits(z[i]);
+
+        uint32_t hash = bx * 73856093u ^ by * 19349663u ^ bz * 83492791u;
+        hash ^= hash >> 16;
+        unsigned int slot = hash & mask;
+
+        for(;;){
+            const unsigned int candidate = table[slot];
+
+            if(candidate == EMPTY){
+                // unique verticies are compacted to the front as they are found,
+                // which is safe since unique never passes i
+                table[slot] = unique;
+                x[unique] = x[i];
+                y[unique] = y[i];
+                z[unique] = z[i];
+                remap[i] = unique++;
+                break;
+            }
+
+            if(coordinateBits(x[candidate]) == bx && coordinateBits(y[candidate]) == by &&
+               coordinateBits(z[candidate]) == bz){
+                remap[i] = candidate;
+                break;
+            }
+
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    x.resize(unique);   x.shrink_to_fit();
+    y.resize(unique);   y.shrink_to_fit();
+    z.resize(unique);   z.shrink_to_fit();
+
+    for(unsigned int i = 0; i < indices.size(); i++){
+        indices[i] = remap[indices[i]];
+    }
+}
+
+/*
+ * Builds the list of unique edges from the index buffer. An edge shared by two faces
+ * appears once, so a wireframe drawn from the edge list rasterizes every line exactly
+ * once. Edges are ordered by the first face using them, which groups them by
+ * cluster. Must be called again after the faces or index buffer change.
+ *
+ * Parameters:
+ * 	none
+ *
+ * Returns:
+ *  void
+ */
+void TriangleMesh::buildEdges(){
+    detach();
+    const unsigned int faces = getFaceCount();
+
+    // every face contributes its three edges keyed by (lower, higher) vertex index;
+    // sorting brings the copies of a shared edge together
+    std::vector<std::pair<uint64_t, unsigned int> > halfEdges;
+    halfEdges.reserve(faces * 3);
+
+    for(unsigned int f = 0; f < faces; f++){
+        for(int i = 0; i < 3; i++){
+            uint64_t a = indices[f * 3 + i];
+            uint64_t b = indices[f * 3 + (i + 1) % 3];
+            if(a == b){
+                continue;
+            }
+            if(a > b){
+                std::swap(a, b);
+            }
+            halfEdges.push_back(std::make_pair((a << 32) | b, f));
+        }
+    }
+
+    std::sort(halfEdges.begin(), halfEdges.end());
+
+    // unique edges as (first face, second face, key), so that sorting them
+    // orders the edges by the first face using them
+    std::vector<std::pair<std::pair<unsigned int, unsigned int>, uint64_t> > unique;
+    unique.reserve(halfEdges.size() / 2 + 1);
+
+    for(unsigned int i = 0; i < halfEdges.size(); ){
+        const uint64_t key = halfEdges[i].first;
+        const unsigned int second = i + 1 < halfEdges.size() && halfEdges[i + 1].first == key ?
+                                    halfEdges[i + 1].second : NO_FACE;
+
+        unique.push_back(std::make_pair(std::make_pair(halfEdges[i].second, second), key));
+
+        // skip the remaining copies, including those of non-manifold edges
+        while(i < halfEdges.size() && halfEdges[i].first == key){
+            i++;
+        }
+    }
+
+    std::sort(unique.begin(), unique.end());
+
+    edges.clear();
+    edgeFaces.clear();
+    edges.reserve(unique.size() * 2);
+    edgeFaces.reserve(unique.size() * 2);
+
+    for(unsigned int i = 0; i < unique.size(); i++){
+        edges.push_back(unique[i].second >> 32);
+        edges.push_back(unique[i].second & 0xFFFFFFFF);
+        edgeFaces.push_back(unique[i].first.first);
+        edgeFaces.push_back(unique[i].first.second);
+    }
+
+    edges.shrink_to_fit();
+    edgeFaces.shrink_to_fit();
+}
+
+/*
+ * Makes sure every face has a unit normal. Normals read from the file are kept and
+ * normalized; faces without one, or whose normal is zero, not a number or points
+ * against the face's counter-clockwise winding, get the normal implied by the winding.
+ *
+ * Parameters:
+ * 	none
+ *
+ * Returns:
+ *  void
+ */
+void TriangleMesh::computeNormals(){
+    detach();
+    const unsigned int faces = getFaceCount();
+
+    normalX.resize(faces, NAN);
+    normalY.resize(faces, NAN);
+    normalZ.resize(faces, NAN);
+
+    for(unsigned int f = 0; f < faces; f++){
+        const unsigned int a = indices[f * 3];
+        const unsigned int b = indices[f * 3 + 1];
+        const unsigned int c = indices[f * 3 + 2];
+
+        const double ux = x[b] - x[a], uy = y[b] - y[a], uz = z[b] - z[a];
+        const double vx = x[c] - x[a], vy = y[c] - y[a], vz = z[c] - z[a];
+
+        const double wx = uy * vz - uz * vy;
+        const double wy = uz * vx - ux * vz;
+        const double wz = ux * vy - uy * vx;
+
+        double nx = normalX[f], ny = normalY[f], nz = normalZ[f];
+        double length = std::sqrt(nx * nx + ny * ny + nz * nz);
+
+        // the winding is what decides which side of a face is drawn, so a stored
+        // normal disagreeing with it is taken to be wrong
+        if(!std::isfinite(length) || length < 1e-12 || nx * wx + ny * wy + nz * wz < 0){
+            nx = wx;
+            ny = wy;
+            nz = wz;
+            length = std::sqrt(nx * nx + ny * ny + nz * nz);
+        }
+
+        // degenerate faces are left with a zero normal
+        if(length < 1e-12){
+            length = 1;
+        }
+
+        normalX[f] = nx / length;
+        normalY[f] = ny / length;
+        normalZ[f] = nz / length;
+    }
+}
+
+/*
+ * Splits the edge list into feature edges - edges on the boundary of the mesh or
+ * between faces whose normals differ by more than creaseAngle degrees - and smooth
+ * edges. Requires buildEdges() and computeNormals() to have been called.
+ *
+ * Parameters:
+ * 	creaseAngle - minimum angle in degrees between face normals for an edge to
+ *                 count as a feature
+ *
+ * Returns:
+ *  void
+ */
+void TriangleMesh::findFeatureEdges(double creaseAngle){
+    const double cosCrease = std::cos(creaseAngle * PI / 180.0);
+    const unsigned int edgeCount = getEdgeCount();
+
+    // only the flags change, so a mapped mesh is read where it lies
+    const unsigned int* edgeFaces = getEdgeFaces();
+    const float* normalX = getNormalX();
+    const float* normalY = getNormalY();
+    const float* normalZ = getNormalZ();
+
+    featureFlags.assign(edgeCount, 1);
+    featureAngle = creaseAngle;
+
+    for(unsigned int e = 0; e < edgeCount; e++){
+        const unsigned int f0 = edgeFaces[e * 2];
+        const unsigned int f1 = edgeFaces[e * 2 + 1];
+
+        // boundary edges are always features
+        if(f1 == NO_FACE){
+            continue;
+        }
+
+        const double cosAngle = normalX[f0] * normalX[f1] + normalY[f0] * normalY[f1] +
+                                normalZ[f0] * normalZ[f1];
+
+        featureFlags[e] = cosAngle < cosCrease;
+    }
+}
+
+/*
+ * Computes the axis-aligned bounding box of the whole mesh and of each cluster of
+ * CLUSTER_SIZE consecutive faces, so that parts of the mesh out of view can be
+ * skipped without looking at their faces.
+ *
+ * Parameters:
+ * 	none
+ *
+ * Returns:
+ *  void
+ */
+void TriangleMesh::computeBounds(){
+    detach();
+    const unsigned int faces = getFaceCount();
+    const unsigned int clusters = getClusterCount();
+
+    clusterBounds.resize(clusters * 6);
+
+    for(unsigned int c = 0; c < clusters; c++){
+        float* box = &clusterBounds[c * 6];
+        box[0] = box[1] = box[2] = INFINITY;
+        box[3] = box[4] = box[5] = -INFINITY;
+
+        const unsigned int last = std::min(faces, (c + 1) * CLUSTER_SIZE);
+        for(unsigned int i = c * CLUSTER_SIZE * 3; i < last * 3; i++){
+            const unsigned int v = indices[i];
+            box[0] = std::min(box[0], x[v]);    box[3] = std::max(box[3], x[v]);
+            box[1] = std::min(box[1], y[v]);    box[4] = std::max(box[4], y[v]);
+            box[2] = std::min(box[2], z[v]);    box[5] = std::max(box[5], z[v]);
+        }
+
+        for(int i = 0; i < 3; i++){
+            bounds[i] = c == 0 ? box[i] : std::min(bounds[i], box[i]);
+            bounds[i + 3] = c == 0 ? box[i + 3] : std::max(bounds[i + 3], box[i + 3]);
+        }
+    }
+}
+
+/*
+ * Writes the mesh to a file which map() can use in place. Each array is stored
+ * in the byte order of this machine in its own aligned section. The mesh must be
+ * finished: welded, with its edges, normals, feature edges and bounds found.
+ *
+ * Parameters:
+ * 	path - name of the file to write
+ *  sourceSize, sourceTime - size and modification time in nanoseconds of the
+ *                           file the mesh was read from
+ *
+ * Returns:
+ *  true if the file was written
+ */
+bool TriangleMesh::save(const std::string& path, unsigned long long sourceSize, long long sourceTime) const{
+    MeshFileHeader header = {};
+    std::memcpy(header.magic, MESH_FILE_MAGIC, sizeof(header.magic));
+    header.version = MESH_FILE_VERSION;
+    header.byteOrder = MESH_FILE_BYTE_ORDER;
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    header.featureAngle = featureAngle;
+    std::memcpy(header.bounds, bounds, sizeof(header.bounds));
+    header.vertexCount = getVertexCount();
+    header.faceCount = getFaceCount();
+    header.edgeCount = getEdgeCount();
+    header.normals = hasNormals();
+
+    const void* data[SECTION_COUNT] = {getX(), getY(), getZ(), getIndices(), getColors(),
+                                       getNormalX(), getNormalY(), getNormalZ(), getEdges(),
+                                       getEdgeFaces(), getFeatureFlags(), getClusterBounds()};
+    sectionSizes(header, header.size);
+
+    // feature flags and bounds are only there once the mesh is finished
+    if(featureFlags.size() != header.size[SECTION_FEATURE_FLAGS] ||
+       (!mapping && clusterBounds.size() * sizeof(float) != header.size[SECTION_CLUSTER_BOUNDS])){
+        return false;
+    }
+
+    uint64_t offset = alignSection(sizeof(header));
+    for(int s = 0; s < SECTION_COUNT; s++){
+        header.offset[s] = offset;
+        offset = alignSection(offset + header.size[s]);
+    }
+
+    // a uniquely named file next to the mesh, so that readers saving the same
+    // mesh at the same time do not write over each other
+    std::string temporary = path + ".XXXXXX";
+    const int fd = mkstemp(&temporary[0]);
+    if(fd < 0){
+        return false;
+    }
+
+    // mkstemp makes the file private to its owner, but a mesh cached next to a
+    // shared model should be as readable as any other file written there
+    const mode_t mask = umask(0);
+    umask(mask);
+    fchmod(fd, 0666 & ~mask);
+    static const char padding[MESH_FILE_ALIGNMENT] = {};
+
+    bool complete = writeAll(fd, &header, sizeof(header));
+    uint64_t written = sizeof(header);
+    for(int s = 0; s < SECTION_COUNT && complete; s++){
+        complete = writeAll(fd, padding, header.offset[s] - written) &&
+                   writeAll(fd, data[s], header.size[s]);
+        written = header.offset[s] + header.size[s];
+    }
+    complete = close(fd) == 0 && complete;
+
+    // only a complete file is moved into place, so a reader never maps half of one
+    if(!complete || std::rename(temporary.c_str(), path.c_str()) != 0){
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Replaces the mesh with one written by save(), mapping the file into memory and
+ * using its arrays where they lie rather than reading them. They are copied out
+ * only if the mesh is changed. Files from another version of this format,
+ * another byte order or another version of the source are not used.
+ *
+ * Parameters:
+ * 	path - name of the file to map
+ *  sourceSize, sourceTime - size and modification time in nanoseconds of the
+ *                           file the mesh was read from
+ *
+ * Returns:
+ *  true if the mesh was mapped, false if it is unchanged
+ */
+bool TriangleMesh::map(const std::string& path, unsigned long long sourceSize, long long sourceTime){
+    const int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0){
+        return false;
+    }
+
+    struct stat info;
+    void* data = MAP_FAILED;
+    if(fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && (uint64_t)info.st_size >= sizeof(MeshFileHeader)){
+        data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if(data == MAP_FAILED){
+        return false;
+    }
+
+    // unmapped again however this returns, unless the mesh keeps it
+    std::shared_ptr<Mapping> file(new Mapping(data, info.st_size));
+    const char* base = static_cast<const char*>(data);
+    const MeshFileHeader& header = *reinterpret_cast<const MeshFileHeader*>(base);
+
+    // a finished mesh always has normals, which shading and culling read for every face
+    bool valid = std::memcmp(header.magic, MESH_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version == MESH_FILE_VERSION && header.byteOrder == MESH_FILE_BYTE_ORDER &&
+                 header.sourceSize == sourceSize && header.sourceTime == sourceTime &&
+                 (header.normals || header.faceCount == 0);
+
+    uint64_t size[SECTION_COUNT];
+    sectionSizes(header, size);
+    for(int s = 0; s < SECTION_COUNT && valid; s++){
+        valid = header.offset[s] % MESH_FILE_ALIGNMENT == 0 && header.size[s] == size[s] &&
+                header.offset[s] <= file->size && size[s] <= file->size - header.offset[s];
+    }
+    if(!valid){
+        return false;
+    }
+
+    // every index must lie inside the arrays it refers to - the first face of an
+    // edge always exists, the second is NO_FACE on a boundary
+    const unsigned int* indices = reinterpret_cast<const unsigned int*>(base + header.offset[SECTION_INDICES]);
+    const unsigned int* edges = reinterpret_cast<const unsigned int*>(base + header.offset[SECTION_EDGES]);
+    const unsigned int* edgeFaces = reinterpret_cast<const unsigned int*>(base + header.offset[SECTION_EDGE_FACES]);
+    const uint64_t edgeEnds = (uint64_t)header.edgeCount * 2;
+
+    if(!indicesBelow(indices, (uint64_t)header.faceCount * 3, header.vertexCount) ||
+       !indicesBelow(edges, edgeEnds, header.vertexCount)){
+        return false;
+    }
+    for(uint64_t e = 0; e < edgeEnds; e += 2){
+        if(edgeFaces[e] >= header.faceCount ||
+           (edgeFaces[e + 1] >= header.faceCount && edgeFaces[e + 1] != NO_FACE)){
+            return false;
+        }
+    }
+
+    file->x = reinterpret_cast<const float*>(base + header.offset[SECTION_X]);
+    file->y = reinterpret_cast<const float*>(base + header.offset[SECTION_Y]);
+    file->z = reinterpret_cast<const float*>(base + header.offset[SECTION_Z]);
+    file->indices = indices;
+    file->colors = reinterpret_cast<const unsigned int*>(base + header.offset[SECTION_COLORS]);
+    file->normalX = reinterpret_cast<const float*>(base + header.offset[SECTION_NORMAL_X]);
+    file->normalY = reinterpret_cast<const float*>(base + header.offset[SECTION_NORMAL_Y]);
+    file->normalZ = reinterpret_cast<const float*>(base + header.offset[SECTION_NORMAL_Z]);
+    file->edges = edges;
+    file->edgeFaces = edgeFaces;
+    file->clusterBounds = reinterpret_cast<const float*>(base + header.offset[SECTION_CLUSTER_BOUNDS]);
+    file->vertexCount = header.vertexCount;
+    file->faceCount = header.faceCount;
+    file->edgeCount = header.edgeCount;
+    file->normals = header.normals;
+
+    clear();
+
+    // the flags are redone whenever the crease angle changes, so they are copied
+    const unsigned char* flags = reinterpret_cast<const unsigned char*>(base + header.offset[SECTION_FEATURE_FLAGS]);
+    featureFlags.assign(flags, flags + header.edgeCount);
+    featureAngle = header.featureAngle;
+    std::memcpy(bounds, header.bounds, sizeof(bounds));
+
+    mapping = file;
+    return true;
+}
+
+/*
+ * Removes all faces from the mesh.
+ *
+ * Parameters:
+ * 	none
+ *
+ * Returns:
+ *  void
+ */
+void TriangleMesh::clear(){
+    mapping.reset();
+    x.clear();          y.clear();          z.clear();
+    indices.clear();
+    colors.clear();
+    edges.clear();
+    edgeFaces.clear();
+    featureFlags.clear();
+    clusterBounds.clear();
+    normalX.clear();    normalY.clear();    normalZ.clear();
+    for(int i = 0; i < 6; i++){
+        bounds[i] = 0;
+    }
+    featureAngle = 0;
+}
+
+/*
+ * Returns the crease angle in degrees of the last call to findFeatureEdges().
+ */
+double TriangleMesh::getCreaseAngle() const{
+    return featureAngle;
+}
+
+/*
+ * Returns the number of faces in the mesh.
+ */
+unsigned int TriangleMesh::getFaceCount() const{
+    return mapping ? mapping->faceCount : colors.size();
+}
+
+/*
+ * Returns the number of verticies in the mesh.
+ */
+unsigned int TriangleMesh::getVertexCount() const{
+    return mapping ? mapping->vertexCount : x.size();
+}
+
+/*
+ * Returns pointers to the vertex coordinate arrays, getVertexCount() entries each.
+ */
+const float* TriangleMesh::getX() const{ return mapping ? mapping->x : x.data(); }
+const float* TriangleMesh::getY() const{ return mapping ? mapping->y : y.data(); }
+const float* TriangleMesh::getZ() const{ return mapping ? mapping->z : z.data(); }
+
+/*
+ * Returns a pointer to the index buffer, 3 * getFaceCount() entries. Face f uses
+ * verticies getIndices()[3f], [3f+1] and [3f+2].
+ */
+const unsigned int* TriangleMesh::getIndices() const{
+    return mapping ? mapping->indices : indices.data();
+}
+
+/*
+ * Returns the number of unique edges found by buildEdges().
+ */
+unsigned int TriangleMesh::getEdgeCount() const{
+    return mapping ? mapping->edgeCount : edges.size() / 2;
+}
+
+/*
+ * Returns a pointer to the edge list, 2 * getEdgeCount() entries. Edge e joins
+ * verticies getEdges()[2e] and [2e+1].
+ */
+const unsigned int* TriangleMesh::getEdges() const{
+    return mapping ? mapping->edges : edges.data();
+}
+
+/*
+ * Returns a pointer to the faces on either side of each edge, 2 * getEdgeCount()
+ * entries. The second face of an edge on the boundary of the mesh is NO_FACE.
+ */
+const unsigned int* TriangleMesh::getEdgeFaces() const{
+    return mapping ? mapping->edgeFaces : edgeFaces.data();
+}
+
+/*
+ * Returns a pointer to one flag per edge, set by findFeatureEdges() for feature
+ * edges. The others are only drawn in feature mode when they lie on the silhouette.
+ */
+const unsigned char* TriangleMesh::getFeatureFlags() const{
+    return featureFlags.data();
+}
+
+/*
+ * Returns the number of face clusters, each of CLUSTER_SIZE faces except perhaps
+ * the last. Face f is in cluster f / CLUSTER_SIZE.
+ */
+unsigned int TriangleMesh::getClusterCount() const{
+    return (getFaceCount() + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+}
+
+/*
+ * Returns a pointer to the cluster bounding boxes found by computeBounds(), six
+ * floats per cluster: minimum x, y and z followed by maximum x, y and z.
+ */
+const float* TriangleMesh::getClusterBounds() const{
+    return mapping ? mapping->clusterBounds : clusterBounds.data();
+}
+
+/*
+ * Returns a pointer to the bounding box of the whole mesh, laid out as a cluster
+ * bounding box.
+ */
+const float* TriangleMesh::getBounds() const{
+    return bounds;
+}
+
+/*
+ * Returns a pointer to the packed per-face colors, getFaceCount() entries.
+ */
+const unsigned int* TriangleMesh::getColors() const{
+    return mapping ? mapping->colors : colors.data();
+}
+
+/*
+ * Returns true if per-face normals are stored.
+ */
+bool TriangleMesh::hasNormals() const{
+    if(mapping){
+        return mapping->normals;
+    }
+    return !colors.empty() && normalX.size() == colors.size();
+}
+
+/*
+ * Returns pointers to the per-face normal arrays, getFaceCount() entries each,
+ * or empty arrays if hasNormals() is false.
+ */
+const float* TriangleMesh::getNormalX() const{ return mapping ? mapping->normalX : normalX.data(); }
+const float* TriangleMesh::getNormalY() const{ return mapping ? mapping->normalY : normalY.data(); }
+const float* TriangleMesh::getNormalZ() const{ return mapping ? mapping->normalZ : normalZ.data(); }
+
+/*
+ * Copies the arrays of a mapped mesh into the mesh's own storage and releases
+ * the mapping, so that they can be changed.
+ *
+ * Parameters:
+ * 	none
+ *
+ * Returns:
+ *  void
+ */
+void TriangleMesh::detach(){
+    if(!mapping){
+        return;
+    }
+
+    const Mapping& file = *mapping;
+    const unsigned int faces = file.faceCount;
+    const unsigned int normals = file.normals ? faces : 0;
+    const unsigned int clusters = getClusterCount();
+
+    x.assign(file.x, file.x + file.vertexCount);
+    y.assign(file.y, file.y + file.vertexCount);
+    z.assign(file.z, file.z + file.vertexCount);
+    indices.assign(file.indices, file.indices + faces * 3);
+    colors.assign(file.colors, file.colors + faces);
+    normalX.assign(file.normalX, file.normalX + normals);
+    normalY.assign(file.normalY, file.normalY + normals);
+    normalZ.assign(file.normalZ, file.normalZ + normals);
+    edges.assign(file.edges, file.edges + file.edgeCount * 2);
+    edgeFaces.assign(file.edgeFaces, file.edgeFaces + file.edgeCount * 2);
+    clusterBounds.assign(file.clusterBounds, file.clusterBounds + clusters * 6);
+
+    mapping.reset();
+}
+
+/*
+ * Constructor taking ownership of a mapped mesh file; the arrays are set by map().
+ */
+TriangleMesh::Mapping::Mapping(void* data, size_t size) : data(data), size(size){
+}
+
+/*
+ * Destructor unmapping the file.
+ */
+TriangleMesh::Mapping::~Mapping(){
+    munmap(data, size);
+}
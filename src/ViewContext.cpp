@@ -6,6 +6,13 @@
  */
 
 #include "ViewContext.h"
+#include "matrix_kernels.h"
+
+#include <algorithm>
+
+// source of projection revisions, shared by all ViewContexts so that a revision
+// is never handed out twice
+static unsigned long lastProjectionRevision = 0;
 
 /* 
 * This is a constructor for the ViewContext object. The ViewContext object requires that the reference
@@ -24,13 +31,11 @@
 ViewContext::ViewContext(int x0, int y0, int z0, int x, int y, double zf){
     this->zf = zf;
     hdeg = vdeg = 0;
+    viewDirty = true;
+    projectionRevision = ++lastProjectionRevision;
 
-    p0 = new matrix(3,1);
-    pref = new matrix(3,1);
-
-    (*p0)[0][0] = x0;   (*pref)[0][0] = 0;
-    (*p0)[1][0] = y0;   (*pref)[1][0] = 0;
-    (*p0)[2][0] = z0;   (*pref)[2][0] = 0;
+    p0 = Vec3(x0, y0, z0);
+    pref = Vec3(0, 0, 0);
 
     createTransformMatricies();
     transformBasis();
@@ -44,15 +49,7 @@ ViewContext::ViewContext(int x0, int y0, int z0, int x, int y, double zf){
  * Outputs:
  *      none
  */
-ViewContext::~ViewContext(){
-    delete changeBasisMatrix;
-    delete toModelCoordinates;
-    delete toDeviceCoordinates;
-    delete translateToOrigin;
-    delete translateFromOrigin;
-    delete hOrbitMatrix;
-    delete vOrbitMatrix;
-}
+ViewContext::~ViewContext(){}
 
 /* 
  * This function converts the device coordinates observed on the screen into model coordinates. Essentially,
@@ -67,7 +64,7 @@ ViewContext::~ViewContext(){
 matrix* ViewContext::deviceToModel(matrix* shapeVerticies){
     matrix* deviceCoordinates = new matrix(4,3);
 
-    *deviceCoordinates = (*changeBasisMatrix * *shapeVerticies);
+    *deviceCoordinates = changeBasisMatrix.toMatrix() * *shapeVerticies;
 
     return deviceCoordinates;
 }
@@ -82,20 +79,268 @@ matrix* ViewContext::deviceToModel(matrix* shapeVerticies){
  *      matrix* - pointer to transformed matrix object
  */
 matrix* ViewContext::modelToDevice(matrix* shapeVerticies){
-    matrix* deviceCoordinates = new matrix(4,3);
+    Mat<4,3> verticies(*shapeVerticies);
 
-    *deviceCoordinates = (*hOrbitMatrix * *shapeVerticies);
-    *deviceCoordinates = (*vOrbitMatrix * *deviceCoordinates);
-    *deviceCoordinates = (*changeBasisMatrix * *deviceCoordinates);
-    project(deviceCoordinates);
-    *deviceCoordinates = *toDeviceCoordinates * *deviceCoordinates;
+    verticies = viewMatrix() * verticies;
+    project(verticies);
+    verticies = toDeviceCoordinates * verticies;
 
-    return deviceCoordinates;
+    return new matrix(verticies.toMatrix());
+}
+
+/* 
+ * First stage of the batch transform: applies the 3D view transform and produces homogeneous
+ * coordinates x, y and w = (zf - z) / zf, where z is the view depth. The perspective divide is
+ * left to clipToDevice so that edges can first be clipped against the near plane. The result
+ * only depends on the orbit state and FOV, so it stays valid for as long as
+ * getProjectionRevision is unchanged.
+ * 
+ * Inputs:
+ *      x, y, z - model coordinates of the verticies, n entries each
+ *      n - number of verticies
+ *      clipX, clipY, clipW - caller supplied arrays of n entries which receive the homogeneous
+ *                            coordinates
+ * Outputs:
+ *      none, but contents of clipX, clipY and clipW are changed
+ */
+void ViewContext::modelToClip(const float* x, const float* y, const float* z, unsigned int n,
+                              float* clipX, float* clipY, float* clipW) const{
+    // w = 1 - z / zf is linear in the model coordinates, so it takes the place of
+    // the depth row and the whole stage is one matrix product
+    Mat4 clip = viewMatrix();
+    for(unsigned int j = 0; j < 4; j++){
+        clip[2][j] = -clip[2][j] / zf;
+    }
+    clip[2][3] += 1.0;
+
+    mat4TransformPoints(clip.data(), x, y, z, n, clipX, clipY, clipW);
+}
+
+/* 
+ * Second stage of the batch transform: performs the perspective divide on coordinates produced
+ * by modelToClip and applies the 2D scale, rotate and translate, in one pass. Verticies behind
+ * the near plane must have been clipped first; their device coordinates are meaningless.
+ * 
+ * Inputs:
+ *      clipX, clipY, clipW - homogeneous coordinates, n entries each
+ *      n - number of verticies
+ *      deviceX, deviceY - caller supplied arrays of n entries which receive the device coordinates
+ * Outputs:
+ *      none, but contents of deviceX and deviceY are changed
+ */
+void ViewContext::clipToDevice(const float* clipX, const float* clipY, const float* clipW, unsigned int n,
+                               float* deviceX, float* deviceY) const{
+    // scale, rotate and translate never mix depth into x and y, so only the
+    // 2D affine part of toDeviceCoordinates is needed
+    const Mat4& device = toDeviceCoordinates;
+    const double a = device[0][0], b = device[0][1], c = device[0][3];
+    const double d = device[1][0], e = device[1][1], f = device[1][3];
+
+    for(unsigned int i = 0; i < n; i++){
+        // held on the near plane so that unclipped verticies stay finite
+        const double scale = 1.0 / std::max((double)clipW[i], NEAR_PLANE);
+        const double px = clipX[i] * scale, py = clipY[i] * scale;
+        deviceX[i] = a * px + b * py + c;
+        deviceY[i] = d * px + e * py + f;
+    }
+}
+
+/* 
+ * Clips an edge in homogeneous coordinates against the near plane w = NEAR_PLANE. An end behind
+ * the plane is moved along the edge onto it.
+ * 
+ * Inputs:
+ *      x, y, w - homogeneous coordinates of the two ends of the edge, 2 entries each
+ * Outputs:
+ *      false if the whole edge is behind the near plane, in which case nothing is changed
+ */
+bool ViewContext::clipToNearPlane(float* x, float* y, float* w){
+    const bool behind0 = w[0] < NEAR_PLANE;
+    const bool behind1 = w[1] < NEAR_PLANE;
+
+    if(behind0 && behind1){
+        return false;
+    }
+
+    if(behind0 || behind1){
+        const int out = behind0 ? 0 : 1;
+        const int in = 1 - out;
+        const double t = (NEAR_PLANE - w[in]) / ((double)w[out] - w[in]);
+
+        x[out] = x[in] + t * (x[out] - x[in]);
+        y[out] = y[in] + t * (y[out] - y[in]);
+        w[out] = NEAR_PLANE;
+    }
+
+    return true;
+}
+
+/* 
+ * Clips a convex polygon in homogeneous coordinates against the near plane w = NEAR_PLANE,
+ * keeping the part in front of it.
+ * 
+ * Inputs:
+ *      x, y, w - homogeneous coordinates of the corners in order, n entries each
+ *      n - number of corners
+ *      outX, outY, outW - caller supplied arrays of n + 1 entries which receive the corners
+ *                         of the clipped polygon
+ * Outputs:
+ *      number of corners of the clipped polygon, 0 if it is wholly behind the near plane
+ */
+unsigned int ViewContext::clipToNearPlane(const float* x, const float* y, const float* w, unsigned int n,
+                                          float* outX, float* outY, float* outW){
+    unsigned int count = 0;
+
+    // each edge keeps its start if that is in front, and adds the point
+    // where it crosses the plane if it does
+    for(unsigned int i = 0; i < n; i++){
+        const unsigned int j = (i + 1) % n;
+        const bool inFront = w[i] >= NEAR_PLANE;
+
+        if(inFront){
+            outX[count] = x[i];     outY[count] = y[i];     outW[count] = w[i];
+            count++;
+        }
+
+        if(inFront != (w[j] >= NEAR_PLANE)){
+            const double t = (NEAR_PLANE - w[i]) / ((double)w[j] - w[i]);
+            outX[count] = x[i] + t * (x[j] - x[i]);
+            outY[count] = y[i] + t * (y[j] - y[i]);
+            outW[count] = NEAR_PLANE;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/* 
+ * Returns a number identifying the current 3D view state (orbit, basis and FOV). It changes every
+ * time that state changes, and is never repeated by any ViewContext, so callers caching the output
+ * of modelToClip can compare it against the revision they cached with.
+ * 
+ * Inputs:
+ *      none
+ * Outputs:
+ *      current projection revision, never 0
+ */
+unsigned long ViewContext::getProjectionRevision() const{
+    return projectionRevision;
+}
+
+/* 
+ * Returns the position of the eye (the center of projection) in model coordinates, taking the
+ * current orbit into account. A face whose normal points towards this position is facing the
+ * viewer.
+ * 
+ * Inputs:
+ *      none
+ * Outputs:
+ *      eye position in model coordinates
+ */
+Vec3 ViewContext::getEyePosition() const{
+    const Mat4& view = viewMatrix();
+
+    // the perspective divide is by w = (zf - z) / zf, which puts the center of
+    // projection at (0, 0, zf) in view coordinates. Solve view * eye = (0, 0, zf, 1) for eye
+    // by inverting the 3x3 part of view.
+    const double bx = -view[0][3];
+    const double by = -view[1][3];
+    const double bz = zf - view[2][3];
+
+    const double c00 = view[1][1] * view[2][2] - view[1][2] * view[2][1];
+    const double c01 = view[1][2] * view[2][0] - view[1][0] * view[2][2];
+    const double c02 = view[1][0] * view[2][1] - view[1][1] * view[2][0];
+    const double det = view[0][0] * c00 + view[0][1] * c01 + view[0][2] * c02;
+
+    const double i00 = c00;
+    const double i01 = view[0][2] * view[2][1] - view[0][1] * view[2][2];
+    const double i02 = view[0][1] * view[1][2] - view[0][2] * view[1][1];
+    const double i10 = c01;
+    const double i11 = view[0][0] * view[2][2] - view[0][2] * view[2][0];
+    const double i12 = view[0][2] * view[1][0] - view[0][0] * view[1][2];
+    const double i20 = c02;
+    const double i21 = view[0][1] * view[2][0] - view[0][0] * view[2][1];
+    const double i22 = view[0][0] * view[1][1] - view[0][1] * view[1][0];
+
+    return Vec3(
+        (i00 * bx + i01 * by + i02 * bz) / det,
+        (i10 * bx + i11 * by + i12 * bz) / det,
+        (i20 * bx + i21 * by + i22 * bz) / det);
+}
+
+/* 
+ * Tests an axis-aligned box in model coordinates against the view frustum: the part of space
+ * in front of the near plane that the view basis, orbit, projection distance zf and current 2D
+ * transform map into a window of the given size. The test is conservative - it may accept a box that is just out of view,
+ * but never rejects one with any part in view.
+ * 
+ * Inputs:
+ *      box - minimum x, y and z followed by maximum x, y and z
+ *      width, height - size of the window in pixels
+ * Outputs:
+ *      false if nothing in the box can be seen
+ */
+bool ViewContext::boxVisible(const float* box, int width, int height) const{
+    const Mat4& view = viewMatrix();
+
+    // bounds of the box in view coordinates, from its transformed center and the
+    // extent of its half size along each view axis
+    const double center[3] = {(box[0] + box[3]) / 2.0, (box[1] + box[4]) / 2.0, (box[2] + box[5]) / 2.0};
+    const double half[3] = {(box[3] - box[0]) / 2.0, (box[4] - box[1]) / 2.0, (box[5] - box[2]) / 2.0};
+    double low[3], high[3];
+
+    for(int r = 0; r < 3; r++){
+        double c = view[r][3];
+        double e = 0;
+        for(int k = 0; k < 3; k++){
+            c += view[r][k] * center[k];
+            e += std::abs(view[r][k]) * half[k];
+        }
+        low[r] = c - e;
+        high[r] = c + e;
+    }
+
+    // a box wholly behind the near plane is never drawn
+    const double nearW = std::max(1.0 - high[2] / zf, NEAR_PLANE);
+    const double farW = 1.0 - low[2] / zf;
+    if(farW < NEAR_PLANE){
+        return false;
+    }
+
+    // projection scales x and y by 1 / w, which is largest on the near side of
+    // the box, after clipping, and smallest on the far side
+    const double largest = 1.0 / nearW;
+    const double smallest = 1.0 / farW;
+
+    double projectedLow[2], projectedHigh[2];
+    for(int r = 0; r < 2; r++){
+        projectedLow[r] = low[r] * (low[r] < 0 ? largest : smallest);
+        projectedHigh[r] = high[r] * (high[r] > 0 ? largest : smallest);
+    }
+
+    // the device transform is a 2D affine map, so the projected rectangle lands
+    // inside the bounds of its transformed corners
+    const Mat4& device = toDeviceCoordinates;
+    double minX = INFINITY, maxX = -INFINITY, minY = INFINITY, maxY = -INFINITY;
+
+    for(int corner = 0; corner < 4; corner++){
+        const double px = corner & 1 ? projectedHigh[0] : projectedLow[0];
+        const double py = corner & 2 ? projectedHigh[1] : projectedLow[1];
+        const double dx = device[0][0] * px + device[0][1] * py + device[0][3];
+        const double dy = device[1][0] * px + device[1][1] * py + device[1][3];
+        minX = std::min(minX, dx);    maxX = std::max(maxX, dx);
+        minY = std::min(minY, dy);    maxY = std::max(maxY, dy);
+    }
+
+    // a pixel of margin covers truncation to whole device coordinates
+    return maxX >= -1 && minX <= width && maxY >= -1 && minY <= height;
 }
 
 /**
  * This function acepts the 3D matrix and projects the points into 2D space. This changes the
- * x and y values, but does not change the z values.
+ * x and y values, but does not change the z values. Points behind the near plane are held on
+ * it rather than clipped.
  * 
  * Inputs:
  *      a - pointer to matrix on which to perform 2D projection
@@ -104,12 +349,29 @@ matrix* ViewContext::modelToDevice(matrix* shapeVerticies){
  */
 void ViewContext::project(matrix* a){
     for(int i = 0; i < 3; i++){
+        double scale = 1.0 / std::max(1.0 - (*a)[2][i] / zf, NEAR_PLANE);
         for(int j = 0; j < 2; j++){
-            (*a)[j][i] = (zf * (*a)[j][i]) / (std::abs((*a)[2][i]) + zf);
+            (*a)[j][i] *= scale;
         }
     }
 }
 
+/**
+ * Fixed size overload of project for the three verticies of a triangle.
+ * 
+ * Inputs:
+ *      a - reference to verticies on which to perform 2D projection
+ * Outputs:
+ *      none, but contents of a are changed
+ */
+void ViewContext::project(Mat<4,3>& a) const{
+    for(int i = 0; i < 3; i++){
+        double scale = 1.0 / std::max(1.0 - a[2][i] / zf, NEAR_PLANE);
+        a[0][i] *= scale;
+        a[1][i] *= scale;
+    }
+}
+
 /* 
  * This function applies a scale to the exisiting transformation matrix, while simultaneously updating the 
  * inverse transformation matrix.
@@ -121,8 +383,8 @@ void ViewContext::project(matrix* a){
  *      none
  */
 void ViewContext::scale(double a, double b){
-    matrix scale(4,4);
-    matrix undoScale(4,4);
+    Mat4 scale;
+    Mat4 undoScale;
 
     scale[0][0] = a;
     scale[1][1] = b;
@@ -134,8 +396,8 @@ void ViewContext::scale(double a, double b){
     undoScale[2][2] = 1;
     undoScale[3][3] = 1;
 
-    *toDeviceCoordinates = *translateFromOrigin * scale * *translateToOrigin * *toDeviceCoordinates;
-    *toModelCoordinates = *toModelCoordinates * *translateFromOrigin * undoScale * *translateToOrigin;
+    toDeviceCoordinates = translateFromOrigin * scale * translateToOrigin * toDeviceCoordinates;
+    toModelCoordinates = toModelCoordinates * translateFromOrigin * undoScale * translateToOrigin;
 }
 
 /* 
@@ -148,8 +410,8 @@ void ViewContext::scale(double a, double b){
  *      none
  */
 void ViewContext::rotate(double theta_deg){
-    matrix rotate(4,4);
-    matrix undoRotate(4,4);
+    Mat4 rotate;
+    Mat4 undoRotate;
 
     double theta = theta_deg * (PI/180.0);
 
@@ -167,8 +429,8 @@ void ViewContext::rotate(double theta_deg){
     undoRotate[2][2] = 1;
     undoRotate[3][3] = 1;
 
-    *toDeviceCoordinates = (*translateFromOrigin * rotate * *translateToOrigin * *toDeviceCoordinates);
-    *toModelCoordinates = (*toModelCoordinates * *translateFromOrigin * undoRotate * *translateToOrigin);  
+    toDeviceCoordinates = translateFromOrigin * rotate * translateToOrigin * toDeviceCoordinates;
+    toModelCoordinates = toModelCoordinates * translateFromOrigin * undoRotate * translateToOrigin;
 }
 
 /**
@@ -180,7 +442,7 @@ void ViewContext::rotate(double theta_deg){
  *      none
  */
 void ViewContext::hOrbit(double degrees){
-    matrix rotate = matrix::identity(4);
+    Mat4 rotate = Mat4::identity();
 
     double theta = degrees * (PI/180.0);
     hdeg += theta;
@@ -190,7 +452,8 @@ void ViewContext::hOrbit(double degrees){
     rotate[2][0] = -1 * std::sin(hdeg);
     rotate[2][2] = 1 * std::cos(hdeg);
 
-    *hOrbitMatrix = rotate;
+    hOrbitMatrix = rotate;
+    invalidateView();
 }
 
 /**
@@ -202,48 +465,39 @@ void ViewContext::hOrbit(double degrees){
  *      none
  */
 void ViewContext::vOrbit(double degrees){
-    matrix rotate = matrix::identity(4);
-
     double theta = degrees * (PI/180.0);
     vdeg += theta;
 
-    matrix yToPo(3,1);
-    yToPo[0][0] = (*p0)[0][0];
-    yToPo[1][0] = 0;
-    yToPo[2][0] = (*p0)[2][0];
-
-    matrix y(3,1);
-    y[1][0] = 1.0;
+    Vec3 yToPo(p0[0][0], 0, p0[2][0]);
+    Vec3 y(0, 1.0, 0);
 
-    matrix axisOfRot(3,1);
-    axisOfRot = matrix(crossProduct3X1(&yToPo,&y));
+    Vec3 axisOfRot = crossProduct3X1(yToPo,y);
+    double axisLength = std::sqrt(std::pow(axisOfRot[0][0],2) + std::pow(axisOfRot[2][0],2));
 
     //rotate to z axis
-    matrix rotateToZ = matrix::identity(4);
-    rotateToZ[0][0] = axisOfRot[2][0] / std::sqrt(std::pow(axisOfRot[0][0],2) + std::pow(axisOfRot[2][0],2));
-    rotateToZ[0][2] = -1 * axisOfRot[0][0] / std::sqrt(std::pow(axisOfRot[0][0],2) + std::pow(axisOfRot[2][0],2));
-    rotateToZ[2][0] = axisOfRot[0][0] / std::sqrt(std::pow(axisOfRot[0][0],2) + std::pow(axisOfRot[2][0],2));
-    rotateToZ[2][2] = axisOfRot[2][0] / std::sqrt(std::pow(axisOfRot[0][0],2) + std::pow(axisOfRot[2][0],2));
+    Mat4 rotateToZ = Mat4::identity();
+    rotateToZ[0][0] = axisOfRot[2][0] / axisLength;
+    rotateToZ[0][2] = -1 * axisOfRot[0][0] / axisLength;
+    rotateToZ[2][0] = axisOfRot[0][0] / axisLength;
+    rotateToZ[2][2] = axisOfRot[2][0] / axisLength;
 
     //rotate from z axis
-    matrix rotateFromZ = matrix::identity(4);
-    rotateFromZ[0][0] = axisOfRot[2][0] / std::sqrt(std::pow(axisOfRot[0][0],2) + std::pow(axisOfRot[2][0],2));
-    rotateFromZ[0][2] = axisOfRot[0][0] / std::sqrt(std::pow(axisOfRot[0][0],2) + std::pow(axisOfRot[2][0],2));
-    rotateFromZ[2][0] = axisOfRot[0][0] / std::sqrt(std::pow(axisOfRot[0][0],2) + std::pow(axisOfRot[2][0],2));
-    rotateFromZ[2][2] = -1 * axisOfRot[2][0] / std::sqrt(std::pow(axisOfRot[0][0],2) + std::pow(axisOfRot[2][0],2));
+    Mat4 rotateFromZ = Mat4::identity();
+    rotateFromZ[0][0] = axisOfRot[2][0] / axisLength;
+    rotateFromZ[0][2] = axisOfRot[0][0] / axisLength;
+    rotateFromZ[2][0] = axisOfRot[0][0] / axisLength;
+    rotateFromZ[2][2] = -1 * axisOfRot[2][0] / axisLength;
 
 
     //rotate points around z axis
-    matrix rotateZ = matrix::identity(4);
+    Mat4 rotateZ = Mat4::identity();
     rotateZ[0][0] = std::cos(vdeg);
     rotateZ[0][1] = -1 * std::sin(vdeg);
     rotateZ[1][0] = std::sin(vdeg);
     rotateZ[1][1] = std::cos(vdeg);
 
-    matrix zOrbit(4,4);
-    zOrbit = rotateToZ * rotateZ * rotateFromZ;
-
-    *vOrbitMatrix = zOrbit;
+    vOrbitMatrix = rotateToZ * rotateZ * rotateFromZ;
+    invalidateView();
 }
 
 /* 
@@ -257,8 +511,8 @@ void ViewContext::vOrbit(double degrees){
  *      none
  */
 void ViewContext::translate(int x, int y){
-    matrix translate = matrix::identity(4);
-    matrix undoTranslate = matrix::identity(4);
+    Mat4 translate = Mat4::identity();
+    Mat4 undoTranslate = Mat4::identity();
 
     translate[0][3] = x;
     translate[1][3] = y;
@@ -266,8 +520,8 @@ void ViewContext::translate(int x, int y){
     undoTranslate[0][3] = -x;
     undoTranslate[1][3] = -y;
 
-    *toDeviceCoordinates = (*translateFromOrigin * translate * *translateToOrigin * *toDeviceCoordinates);
-    *toModelCoordinates = (*toModelCoordinates * *translateFromOrigin * undoTranslate * *translateToOrigin);
+    toDeviceCoordinates = translateFromOrigin * translate * translateToOrigin * toDeviceCoordinates;
+    toModelCoordinates = toModelCoordinates * translateFromOrigin * undoTranslate * translateToOrigin;
 }
 
 /* 
@@ -280,7 +534,7 @@ void ViewContext::translate(int x, int y){
  */
 void ViewContext::reset(){
     resetTransformMatricies();
-    (*toDeviceCoordinates) = *translateFromOrigin * *toDeviceCoordinates;
+    toDeviceCoordinates = translateFromOrigin * toDeviceCoordinates;
 }
 
 /**
@@ -293,6 +547,42 @@ void ViewContext::reset(){
  */
 void ViewContext::adjustFOV(double fov){
     zf += fov;
+    invalidateView();
+}
+
+/**
+ * This is a private helper which returns the orbit and change of basis matricies composed
+ * into the single matrix taking model coordinates to view coordinates. The product is cached
+ * and only recomputed after one of the matricies has changed.
+ * 
+ * Input:
+ *      none
+ * Output:
+ *      composed view matrix
+ */
+const Mat4& ViewContext::viewMatrix() const{
+    if(viewDirty){
+        Mat4 orbit;
+        mat4Multiply(vOrbitMatrix.data(), hOrbitMatrix.data(), orbit.data());
+        mat4Multiply(changeBasisMatrix.data(), orbit.data(), cachedViewMatrix.data());
+        viewDirty = false;
+    }
+    return cachedViewMatrix;
+}
+
+/**
+ * This is a private helper which marks the cached view matrix as stale and starts a new
+ * projection revision. It must be called whenever hOrbitMatrix, vOrbitMatrix,
+ * changeBasisMatrix or zf changes.
+ * 
+ * Input:
+ *      none
+ * Output:
+ *      none
+ */
+void ViewContext::invalidateView(){
+    viewDirty = true;
+    projectionRevision = ++lastProjectionRevision;
 }
 
 /**
@@ -304,35 +594,21 @@ void ViewContext::adjustFOV(double fov){
  *      none
  */
 void ViewContext::transformBasis(){
-    matrix N(3,1);  matrix V(3,1);  matrix L(3,1);
-    N[0][0] = (*p0)[0][0];    N[1][0] = (*p0)[1][0];    N[2][0] = (*p0)[2][0];
-    V[1][0] = 1;
-
-    L = matrix(crossProduct3X1(&V,&N));
-
-    matrix l(normalize(&L));
-    matrix n(normalize(&N));
-    matrix m(crossProduct3X1(&n,&l));
-
-    (*changeBasisMatrix)[0][0] = l[0][0];
-    (*changeBasisMatrix)[0][1] = l[1][0];
-    (*changeBasisMatrix)[0][2] = l[2][0];
-    (*changeBasisMatrix)[0][3] = -1 * dot(&l,p0);
-
-    (*changeBasisMatrix)[1][0] = m[0][0];
-    (*changeBasisMatrix)[1][1] = m[1][0];
-    (*changeBasisMatrix)[1][2] = m[2][0];
-    (*changeBasisMatrix)[1][3] = -1 * dot(&m,p0);
-
-    (*changeBasisMatrix)[2][0] = n[0][0];
-    (*changeBasisMatrix)[2][1] = n[1][0];
-    (*changeBasisMatrix)[2][2] = n[2][0];
-    (*changeBasisMatrix)[2][3] = -1 * dot(&n,p0);
-
-    (*changeBasisMatrix)[3][0] = 0;
-    (*changeBasisMatrix)[3][1] = 0;
-    (*changeBasisMatrix)[3][2] = 0;
-    (*changeBasisMatrix)[3][3] = 1;
+    Vec3 N = p0;
+    Vec3 V(0, 1, 0);
+
+    Vec3 L = crossProduct3X1(V,N);
+
+    Vec3 l = normalize(L);
+    Vec3 n = normalize(N);
+    Vec3 m = crossProduct3X1(n,l);
+
+    changeBasisMatrix = Mat4(
+        l[0][0], l[1][0], l[2][0], -1 * dot(l,p0),
+        m[0][0], m[1][0], m[2][0], -1 * dot(m,p0),
+        n[0][0], n[1][0], n[2][0], -1 * dot(n,p0),
+        0,       0,       0,       1);
+    invalidateView();
 }
 
 /**
@@ -344,14 +620,6 @@ void ViewContext::transformBasis(){
  *      none
  */
 void ViewContext::createTransformMatricies(){
-    toModelCoordinates = new matrix(4,4);
-    toDeviceCoordinates = new matrix(4,4);
-    changeBasisMatrix = new matrix(4,4);
-    translateToOrigin = new matrix(4,4);
-    translateFromOrigin = new matrix(4,4);
-    hOrbitMatrix = new matrix(4,4);
-    vOrbitMatrix = new matrix(4,4);
-
     resetTransformMatricies();
 }
 
@@ -365,17 +633,11 @@ void ViewContext::createTransformMatricies(){
  *      none
  */
 void ViewContext::resetTransformMatricies(){
-    toModelCoordinates->clear();
-    toDeviceCoordinates->clear();
-    hOrbitMatrix->clear();
-    vOrbitMatrix->clear();
-
-    for(int i = 0; i < 4; i++){
-        (*toModelCoordinates)[i][i] = 1.0;
-        (*toDeviceCoordinates)[i][i] = 1.0;
-        (*hOrbitMatrix)[i][i] = 1.0;
-        (*vOrbitMatrix)[i][i] = 1.0;
-    }
+    toModelCoordinates = Mat4::identity();
+    toDeviceCoordinates = Mat4::identity();
+    hOrbitMatrix = Mat4::identity();
+    vOrbitMatrix = Mat4::identity();
+    invalidateView();
 }
 
 /**
@@ -389,80 +651,67 @@ void ViewContext::resetTransformMatricies(){
  *      none
  */
 void ViewContext::originToCenter(double x, double y){
-    (*translateToOrigin)[0][3] = -x;
-    (*translateToOrigin)[1][3] = -y;
-    (*translateFromOrigin)[0][3] = x;
-    (*translateFromOrigin)[1][3] = y;
-
-    for(int i = 0; i < 4; i++){
-        (*translateFromOrigin)[i][i] = 1.0;
-        (*translateToOrigin)[i][i] = 1.0;
-    }
+    translateToOrigin = Mat4::identity();
+    translateFromOrigin = Mat4::identity();
 
-    (*toDeviceCoordinates) = *translateFromOrigin * *toDeviceCoordinates;
+    translateToOrigin[0][3] = -x;
+    translateToOrigin[1][3] = -y;
+    translateFromOrigin[0][3] = x;
+    translateFromOrigin[1][3] = y;
+
+    toDeviceCoordinates = translateFromOrigin * toDeviceCoordinates;
 }
 
 /**
  * This is a private helper method for perfoming the cross product of 2 3X1
- * matricies.
+ * vectors.
  * 
  * Inputs:
- *      a - pointer to the matrix on the left
- *      b - pointer to the matrix on the right
+ *      a - reference to the vector on the left
+ *      b - reference to the vector on the right
  * Outputs:
- *      resulting matrix from cross product.
+ *      resulting vector from cross product.
  */
-matrix ViewContext::crossProduct3X1(matrix* a, matrix* b){
-    matrix result = matrix(3,1);
-
-    result[0][0] = ((*a)[1][0] * (*b)[2][0]) - ((*a)[2][0] * (*b)[1][0]);
-    result[1][0] = -(((*a)[0][0] * (*b)[2][0]) - ((*a)[2][0] * (*b)[0][0]));
-    result[2][0] = ((*a)[0][0] * (*b)[1][0]) - ((*a)[1][0] * (*b)[0][0]);
-
-    return result;
+Vec3 ViewContext::crossProduct3X1(const Vec3& a, const Vec3& b){
+    return Vec3(
+        (a[1][0] * b[2][0]) - (a[2][0] * b[1][0]),
+        -((a[0][0] * b[2][0]) - (a[2][0] * b[0][0])),
+        (a[0][0] * b[1][0]) - (a[1][0] * b[0][0]));
 }
 
 /**
- * Determines the magnitude of a 3X1 matrix.
+ * Determines the magnitude of a 3X1 vector.
  * 
  * Input:
- *  a - pointer to matrix
+ *  a - reference to vector
  * Output:
- *      magnitude of matrix
+ *      magnitude of vector
  */
-double ViewContext::magnitude(matrix* a){
-    return std::sqrt(std::pow((*a)[0][0],2) + std::pow((*a)[1][0],2) + std::pow((*a)[2][0],2));
+double ViewContext::magnitude(const Vec3& a){
+    return std::sqrt(dot(a,a));
 }
 
 /**
- * This is a private helper method for normalizing a matrix.
+ * This is a private helper method for normalizing a vector.
  * 
  * Input:
- *      a - pointer to matrix to be normalized.
+ *      a - reference to vector to be normalized.
  * Output:
- *      resulting normalized matrix
+ *      resulting normalized vector
  */
-matrix ViewContext::normalize(matrix* a){
-    double norm = magnitude(a);
-
-    matrix result = matrix(3,1);
-    result[0][0] = (*a)[0][0] / norm;
-    result[1][0] = (*a)[1][0] / norm;
-    result[2][0] = (*a)[2][0] / norm;
-
-    return result;
+Vec3 ViewContext::normalize(const Vec3& a){
+    return a * (1.0 / magnitude(a));
 }
 
 /**
- * Private helper method for determining the dot product of 2 3X1 matricies
+ * Private helper method for determining the dot product of 2 3X1 vectors
  * 
  * Input:
- *      a - pointer to matrix on the left
- *      b - pointer to matrix on the right
+ *      a - reference to vector on the left
+ *      b - reference to vector on the right
  * Output:
  *      result of dot product
  */
-double ViewContext::dot(matrix* a, matrix* b){
-    double result = (*a)[0][0] * (*b)[0][0] + (*a)[1][0] * (*b)[1][0] + (*a)[2][0] * (*b)[2][0];
-    return result;
+double ViewContext::dot(const Vec3& a, const Vec3& b){
+    return a[0][0] * b[0][0] + a[1][0] * b[1][0] + a[2][0] * b[2][0];
 }
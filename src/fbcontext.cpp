@@ -0,0 +1,733 @@
+/* Provides a drawing context which renders into memory.  Nothing
+ * here needs a display, so it is suitable for headless rendering,
+ * testing and benchmarking.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include "fbcontext.h"
+#include "drawbase.h"
+
+// keysyms for the arrow keys, as delivered by X11
+static const unsigned int KEY_LEFT = 65361;
+static const unsigned int KEY_UP = 65362;
+static const unsigned int KEY_RIGHT = 65363;
+static const unsigned int KEY_DOWN = 65364;
+
+/**
+ * Helper which converts a script key name into a keysym.  Returns
+ * false if the name is not understood.
+ * */
+static bool parseKey(const std::string& name, unsigned int& keysym)
+{
+	if (name.size() == 1)
+		keysym = (unsigned char)name[0];
+	else if (name == "left")
+		keysym = KEY_LEFT;
+	else if (name == "up")
+		keysym = KEY_UP;
+	else if (name == "right")
+		keysym = KEY_RIGHT;
+	else if (name == "down")
+		keysym = KEY_DOWN;
+	else
+	{
+		char* end;
+		keysym = std::strtoul(name.c_str(), &end, 0);
+		return !name.empty() && *end == '\0';
+	}
+	return true;
+}
+
+/**
+ * The only constructor provided.  Allows size of framebuffer and
+ * background color be specified.
+ * */
+FramebufferContext::FramebufferContext(unsigned int sizex,unsigned int sizey,
+						unsigned int bg_color)
+	: width(sizex), height(sizey), background(bg_color),
+	  color(GraphicsContext::WHITE), mode(MODE_NORMAL),
+	  storage(sizex * sizey, bg_color)
+{
+	init();
+	pixels = storage.data();
+	run = false;
+}
+
+/**
+ * Constructor rendering into memory owned by the caller.  The memory
+ * is cleared to the background color.
+ * */
+FramebufferContext::FramebufferContext(unsigned int sizex,unsigned int sizey,
+						unsigned int bg_color, unsigned int* memory)
+	: width(sizex), height(sizey), background(bg_color),
+	  color(GraphicsContext::WHITE), mode(MODE_NORMAL), pixels(memory)
+{
+	init();
+	run = false;
+	clear();
+}
+
+// Sets up the state shared by both constructors
+void FramebufferContext::init()
+{
+	depthDirty = false;
+	inFrame = false;
+	tilesX = tilesY = 0;
+	nextTile = 0;
+	threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	generation = 0;
+	busyWorkers = 0;
+	stopping = false;
+}
+
+// Destructor - stops any worker threads
+FramebufferContext::~FramebufferContext()
+{
+	stopWorkers();
+}
+
+// Set the drawing mode - argument is enumerated
+void FramebufferContext::setMode(drawMode newMode)
+{
+	mode = newMode;
+}
+
+// Set drawing color - 24 bit RGB
+void FramebufferContext::setColor(unsigned int color)
+{
+	this->color = color & 0xFFFFFF;
+}
+
+// Set a pixel in the current color.  Pixels off screen are ignored.
+void FramebufferContext::setPixel(int x, int y)
+{
+	flushTriangles();
+	plotClipped(x, y);
+}
+
+// Get the color of a pixel, or the background if it is off screen
+unsigned int FramebufferContext::getPixel(int x, int y)
+{
+	flushTriangles();
+	if (x < 0 || y < 0 || x >= width || y >= height)
+		return background;
+	return pixels[y * width + x];
+}
+
+// Fill the whole framebuffer with the background color, and reset the
+// depth buffer if anything has been drawn into it
+void FramebufferContext::clear()
+{
+	// queued triangles would be covered anyway
+	for (unsigned int i = 0; i < bins.size(); i++)
+		bins[i].clear();
+	triangles.clear();
+
+	std::fill(pixels, pixels + width * height, background);
+
+	if (depthDirty)
+	{
+		std::fill(depthBuffer.begin(), depthBuffer.end(), 0.0f);
+		depthDirty = false;
+	}
+}
+
+/**
+ * Bresenham line drawn straight into memory.  Lines are first clipped
+ * to the framebuffer and horizontal lines are filled as spans.
+ * */
+void FramebufferContext::drawLine(int x0, int y0, int x1, int y1)
+{
+	// anything queued is underneath
+	flushTriangles();
+
+	// after clipping every pixel of the line is on screen
+	if (!clipLine(x0, y0, x1, y1, width, height))
+		return;
+
+	if (y0 == y1)
+	{
+		FramebufferContext::fillSpan(y0, x0, x1);
+		return;
+	}
+
+	int dx = std::abs(x1 - x0);
+	int dy = -std::abs(y1 - y0);
+	int sx = x0 < x1 ? 1 : -1;
+	int sy = y0 < y1 ? 1 : -1;
+	int err = dx + dy;
+
+	for (;;)
+	{
+		plot(x0, y0);
+
+		if (x0 == x1 && y0 == y1)
+			break;
+
+		int e2 = 2 * err;
+		if (e2 >= dy)
+		{
+			err += dy;
+			x0 += sx;
+		}
+		if (e2 <= dx)
+		{
+			err += dx;
+			y0 += sy;
+		}
+	}
+}
+
+/**
+ * Midpoint circle drawn straight into memory, one octant computed and
+ * mirrored into the other seven.
+ * */
+void FramebufferContext::drawCircle(int x0, int y0, unsigned int radius)
+{
+	flushTriangles();
+
+	int x = radius;
+	int y = 0;
+	int err = 1 - x;
+
+	while (x >= y)
+	{
+		plotClipped(x0 + x, y0 + y);
+		plotClipped(x0 + y, y0 + x);
+		plotClipped(x0 - y, y0 + x);
+		plotClipped(x0 - x, y0 + y);
+		plotClipped(x0 - x, y0 - y);
+		plotClipped(x0 - y, y0 - x);
+		plotClipped(x0 + y, y0 - x);
+		plotClipped(x0 + x, y0 - y);
+
+		y++;
+		if (err < 0)
+			err += 2 * y + 1;
+		else
+		{
+			x--;
+			err += 2 * (y - x) + 1;
+		}
+	}
+}
+
+// Fill a horizontal run a row at a time, clipped to the framebuffer
+void FramebufferContext::fillSpan(int y, int x0, int x1)
+{
+	flushTriangles();
+
+	if (y < 0 || y >= height)
+		return;
+
+	int left = std::max(std::min(x0, x1), 0);
+	int right = std::min(std::max(x0, x1), width - 1);
+	if (left > right)
+		return;
+
+	unsigned int* row = &pixels[y * width];
+	if (mode == MODE_NORMAL)
+		std::fill(row + left, row + right + 1, color);
+	else
+		for (int x = left; x <= right; x++)
+			row[x] ^= color;
+}
+
+// Draw many lines without a virtual call for each
+void FramebufferContext::drawLines(const Segment* segments, unsigned int n)
+{
+	flushTriangles();
+	for (unsigned int i = 0; i < n; i++)
+		FramebufferContext::drawLine(segments[i].x0, segments[i].y0,
+						segments[i].x1, segments[i].y1);
+}
+
+// Set many pixels without a virtual call for each
+void FramebufferContext::setPixels(const Point* points, unsigned int n)
+{
+	flushTriangles();
+	for (unsigned int i = 0; i < n; i++)
+		plotClipped(points[i].x, points[i].y);
+}
+
+/**
+ * Fills a triangle with edge functions.  The triangle is set up and
+ * binned into every tile its bounding box touches; inside a frame the
+ * tiles are only rasterized when the frame ends or something else is
+ * drawn, so that they can be shared out between threads.
+ * */
+void FramebufferContext::fillTriangle(const float* x, const float* y,
+						const float* depth)
+{
+	if (setupTriangle(x, y, depth) && !inFrame)
+		flushTriangles();
+}
+
+// Starts queueing filled triangles
+void FramebufferContext::beginFrame()
+{
+	inFrame = true;
+}
+
+// Rasterizes the triangles queued during the frame
+void FramebufferContext::endFrame()
+{
+	flushTriangles();
+	inFrame = false;
+}
+
+// Sets the number of threads rasterizing tiles, counting the caller.
+// More than a few per hardware thread would only add switching.
+void FramebufferContext::setThreadCount(unsigned int count)
+{
+	flushTriangles();
+	stopWorkers();
+	const unsigned int most = std::max(std::thread::hardware_concurrency(), 1u) * 4;
+	threadCount = std::min(std::max(count, 1u), most);
+}
+
+// Run event loop over the scripted events
+void FramebufferContext::runLoop(DrawingBase* drawing)
+{
+	run = true;
+
+	while (run && !events.empty())
+	{
+		Event e = events.front();
+		events.pop_front();
+
+		if (e.type == EXPOSE)
+			drawing->paint(this);
+
+		else if (e.type == KEY_DOWN)
+			drawing->keyDown(this, e.code);
+
+		else if (e.type == KEY_UP)
+			drawing->keyUp(this, e.code);
+
+		else if (e.type == BUTTON_DOWN)
+			drawing->mouseButtonDown(this, e.code, e.x, e.y);
+
+		else if (e.type == BUTTON_UP)
+			drawing->mouseButtonUp(this, e.code, e.x, e.y);
+
+		else if (e.type == MOUSE_MOVE)
+			drawing->mouseMove(this, e.x, e.y);
+
+		else if (e.type == SAVE)
+		{
+			std::ofstream file(e.path.c_str(), std::ios::binary);
+			writePPM(file);
+		}
+
+		else if (e.type == QUIT)
+			break;
+	}
+
+	run = false;
+}
+
+int FramebufferContext::getWindowWidth()
+{
+	return width;
+}
+
+int FramebufferContext::getWindowHeight()
+{
+	return height;
+}
+
+// Appends an event to the script
+void FramebufferContext::pushEvent(const Event& event)
+{
+	events.push_back(event);
+}
+
+// Appends the events in a text script to the queue - see header for
+// the format
+bool FramebufferContext::loadScript(std::istream& script)
+{
+	std::string line;
+	bool ok = true;
+
+	while (std::getline(script, line))
+	{
+		std::istringstream iss(line);
+		std::string command;
+
+		if (!(iss >> command) || command[0] == '#')
+			continue;
+
+		Event e = {EXPOSE, 0, 0, 0, ""};
+		std::string key;
+
+		if (command == "expose")
+			pushEvent(e);
+
+		else if ((command == "key" || command == "keydown" || command == "keyup") &&
+				 (iss >> key) && parseKey(key, e.code))
+		{
+			if (command != "keyup")
+			{
+				e.type = KEY_DOWN;
+				pushEvent(e);
+			}
+			if (command != "keydown")
+			{
+				e.type = KEY_UP;
+				pushEvent(e);
+			}
+		}
+
+		else if ((command == "press" || command == "release") &&
+				 (iss >> e.code >> e.x >> e.y))
+		{
+			e.type = command == "press" ? BUTTON_DOWN : BUTTON_UP;
+			pushEvent(e);
+		}
+
+		else if (command == "move" && (iss >> e.x >> e.y))
+		{
+			e.type = MOUSE_MOVE;
+			pushEvent(e);
+		}
+
+		else if (command == "drag")
+		{
+			// a press, evenly spaced moves and a release, like a mouse drag
+			int x1, y1, steps;
+			if (!(iss >> e.x >> e.y >> x1 >> y1 >> steps) || steps < 1)
+			{
+				ok = false;
+				continue;
+			}
+
+			int startX = e.x, startY = e.y;
+			e.type = BUTTON_DOWN;
+			e.code = 1;
+			pushEvent(e);
+
+			e.type = MOUSE_MOVE;
+			for (int i = 1; i <= steps; i++)
+			{
+				e.x = startX + (x1 - startX) * i / steps;
+				e.y = startY + (y1 - startY) * i / steps;
+				pushEvent(e);
+			}
+
+			e.type = BUTTON_UP;
+			pushEvent(e);
+		}
+
+		else if (command == "save" && (iss >> e.path))
+		{
+			e.type = SAVE;
+			pushEvent(e);
+		}
+
+		else if (command == "quit")
+		{
+			e.type = QUIT;
+			pushEvent(e);
+		}
+
+		else
+			ok = false;
+	}
+
+	return ok;
+}
+
+const unsigned int* FramebufferContext::getPixels() const
+{
+	return pixels;
+}
+
+
+// Writes the framebuffer as a binary PPM image
+void FramebufferContext::writePPM(std::ostream& os) const
+{
+	os << "P6\n" << width << " " << height << "\n255\n";
+
+	std::vector<char> row(width * 3);
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned int* src = &pixels[y * width];
+		for (int x = 0; x < width; x++)
+		{
+			row[x * 3] = (src[x] >> 16) & 0xFF;
+			row[x * 3 + 1] = (src[x] >> 8) & 0xFF;
+			row[x * 3 + 2] = src[x] & 0xFF;
+		}
+		os.write(row.data(), row.size());
+	}
+}
+
+// Sets a pixel known to be on screen, honouring the draw mode
+inline void FramebufferContext::plot(int x, int y)
+{
+	if (mode == MODE_NORMAL)
+		pixels[y * width + x] = color;
+	else
+		pixels[y * width + x] ^= color;
+}
+
+// Sets a pixel if it is on screen
+void FramebufferContext::plotClipped(int x, int y)
+{
+	if (x >= 0 && y >= 0 && x < width && y < height)
+		plot(x, y);
+}
+
+/**
+ * Works out everything about a triangle that does not depend on the
+ * tile being drawn, and adds it to the bins of the tiles it touches.
+ * Corners are snapped to 1/16 of a pixel so the edge functions are
+ * exact integers.  Returns false if nothing of the triangle is on
+ * screen.
+ * */
+bool FramebufferContext::setupTriangle(const float* x, const float* y,
+						const float* depth)
+{
+	// beyond this the 64 bit edge functions could overflow
+	const float GUARD_BAND = 1 << 25;
+
+	long long fx[3], fy[3];
+	double z[3];
+	for (int i = 0; i < 3; i++)
+	{
+		if (!(std::abs(x[i]) < GUARD_BAND && std::abs(y[i]) < GUARD_BAND))
+			return false;
+		fx[i] = std::lround(x[i] * 16);
+		fy[i] = std::lround(y[i] * 16);
+		z[i] = depth[i];
+	}
+
+	long long area = (fx[1] - fx[0]) * (fy[2] - fy[0]) - (fy[1] - fy[0]) * (fx[2] - fx[0]);
+	if (area == 0)
+		return false;
+
+	// either winding is filled; turn it so the inside is positive
+	if (area < 0)
+	{
+		std::swap(fx[1], fx[2]);
+		std::swap(fy[1], fy[2]);
+		std::swap(z[1], z[2]);
+		area = -area;
+	}
+
+	TriangleSetup t;
+	t.minX = std::max((int)std::floor(std::min({fx[0], fx[1], fx[2]}) / 16.0), 0);
+	t.maxX = std::min((int)std::floor(std::max({fx[0], fx[1], fx[2]}) / 16.0), width - 1);
+	t.minY = std::max((int)std::floor(std::min({fy[0], fy[1], fy[2]}) / 16.0), 0);
+	t.maxY = std::min((int)std::floor(std::max({fy[0], fy[1], fy[2]}) / 16.0), height - 1);
+	if (t.minX > t.maxX || t.minY > t.maxY)
+		return false;
+
+	// edge i runs from corner i to corner i + 1, and its function
+	// a*x + b*y + c at a pixel center is the weight of the opposite
+	// corner scaled by the area
+	for (int i = 0; i < 3; i++)
+	{
+		int j = (i + 1) % 3;
+		long long dx = fx[j] - fx[i], dy = fy[j] - fy[i];
+
+		t.a[i] = -dy * 16;
+		t.b[i] = dx * 16;
+		t.c[i] = dy * (fx[i] - 8) - dx * (fy[i] - 8);
+
+		// pixels exactly on an edge belong to the triangle only when
+		// it is a top or left edge
+		if (!(dy < 0 || (dy == 0 && dx > 0)))
+			t.c[i] -= 1;
+	}
+
+	// depth is a plane in device space: z0 plus the weights of
+	// corners 1 and 2 times their differences from it
+	const double dz1 = (z[1] - z[0]) / area, dz2 = (z[2] - z[0]) / area;
+	t.depthA = t.a[2] * dz1 + t.a[0] * dz2;
+	t.depthB = t.b[2] * dz1 + t.b[0] * dz2;
+	t.depthC = z[0] + t.c[2] * dz1 + t.c[0] * dz2;
+
+	t.color = color;
+	t.mode = mode;
+
+	if (bins.empty())
+	{
+		tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+		tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+		bins.resize(tilesX * tilesY);
+		depthBuffer.assign(tilesX * tilesY * TILE_SIZE * TILE_SIZE, 0.0f);
+	}
+	depthDirty = true;
+
+	const unsigned int index = triangles.size();
+	triangles.push_back(t);
+
+	for (int ty = t.minY / TILE_SIZE; ty <= t.maxY / TILE_SIZE; ty++)
+		for (int tx = t.minX / TILE_SIZE; tx <= t.maxX / TILE_SIZE; tx++)
+			bins[ty * tilesX + tx].push_back(index);
+
+	return true;
+}
+
+/**
+ * Rasterizes every queued triangle.  Tiles cover separate pixels and
+ * separate parts of the depth buffer, so threads can take whole tiles
+ * each without any locking; within a tile triangles are drawn in the
+ * order they were queued.
+ * */
+void FramebufferContext::flushTriangles()
+{
+	if (triangles.empty())
+		return;
+
+	activeTiles.clear();
+	for (unsigned int i = 0; i < bins.size(); i++)
+		if (!bins[i].empty())
+			activeTiles.push_back(i);
+
+	nextTile = 0;
+
+	if (threadCount > 1 && activeTiles.size() > 1)
+	{
+		if (workers.empty())
+			startWorkers();
+
+		{
+			std::lock_guard<std::mutex> lock(poolMutex);
+			busyWorkers = workers.size();
+			generation++;
+		}
+		poolWake.notify_all();
+
+		rasterizeTiles();
+
+		std::unique_lock<std::mutex> lock(poolMutex);
+		poolDone.wait(lock, [this] { return busyWorkers == 0; });
+	}
+	else
+		rasterizeTiles();
+
+	for (unsigned int i = 0; i < activeTiles.size(); i++)
+		bins[activeTiles[i]].clear();
+	triangles.clear();
+}
+
+// Takes tiles off the shared list until none are left
+void FramebufferContext::rasterizeTiles()
+{
+	for (unsigned int i = nextTile++; i < activeTiles.size(); i = nextTile++)
+		rasterizeTile(activeTiles[i]);
+}
+
+/**
+ * Draws the triangles binned into one tile.  The edge functions are
+ * stepped across each row rather than evaluated at every pixel, and a
+ * pixel is only written where its depth is greater than the depth
+ * buffer's, which starts at 0.
+ * */
+void FramebufferContext::rasterizeTile(unsigned int tile)
+{
+	const int tileX = (tile % tilesX) * TILE_SIZE;
+	const int tileY = (tile / tilesX) * TILE_SIZE;
+	float* tileDepth = &depthBuffer[tile * TILE_SIZE * TILE_SIZE];
+	const std::vector<unsigned int>& bin = bins[tile];
+
+	for (unsigned int n = 0; n < bin.size(); n++)
+	{
+		const TriangleSetup& t = triangles[bin[n]];
+
+		const int minX = std::max(t.minX, tileX);
+		const int maxX = std::min(t.maxX, tileX + TILE_SIZE - 1);
+		const int minY = std::max(t.minY, tileY);
+		const int maxY = std::min(t.maxY, tileY + TILE_SIZE - 1);
+
+		for (int y = minY; y <= maxY; y++)
+		{
+			long long e0 = t.a[0] * minX + t.b[0] * y + t.c[0];
+			long long e1 = t.a[1] * minX + t.b[1] * y + t.c[1];
+			long long e2 = t.a[2] * minX + t.b[2] * y + t.c[2];
+			float d = (float)(t.depthA * minX + t.depthB * y + t.depthC);
+			const float depthStep = (float)t.depthA;
+
+			unsigned int* pixel = &pixels[y * width + minX];
+			float* stored = &tileDepth[(y - tileY) * TILE_SIZE + minX - tileX];
+
+			for (int x = minX; x <= maxX; x++)
+			{
+				if ((e0 | e1 | e2) >= 0 && d > *stored)
+				{
+					*stored = d;
+					if (t.mode == MODE_NORMAL)
+						*pixel = t.color;
+					else
+						*pixel ^= t.color;
+				}
+
+				e0 += t.a[0];
+				e1 += t.a[1];
+				e2 += t.a[2];
+				d += depthStep;
+				pixel++;
+				stored++;
+			}
+		}
+	}
+}
+
+// Starts the threads which help the caller rasterize tiles
+void FramebufferContext::startWorkers()
+{
+	// workers replacing stopped ones must not take the last generation
+	// as new work
+	unsigned long current;
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		stopping = false;
+		current = generation;
+	}
+
+	for (unsigned int i = 1; i < threadCount; i++)
+		workers.push_back(std::thread(&FramebufferContext::workerLoop, this, current));
+}
+
+// Stops and joins the worker threads
+void FramebufferContext::stopWorkers()
+{
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		stopping = true;
+	}
+	poolWake.notify_all();
+
+	for (unsigned int i = 0; i < workers.size(); i++)
+		workers[i].join();
+	workers.clear();
+}
+
+// Body of each worker thread - rasterizes tiles each time a flush
+// starts a generation of work after the one it was started in
+void FramebufferContext::workerLoop(unsigned long seen)
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(poolMutex);
+			poolWake.wait(lock, [&] { return stopping || generation != seen; });
+			if (stopping)
+				return;
+			seen = generation;
+		}
+
+		rasterizeTiles();
+
+		std::lock_guard<std::mutex> lock(poolMutex);
+		if (--busyWorkers == 0)
+			poolDone.notify_one();
+	}
+}
@@ -6,10 +6,19 @@
  * Date: march 29 2018
  */
 
-#define _USE_MATH_DEFINES	// for M_PI
 #include <cmath>	// for trig functions
+#include <algorithm>	// for std::max and std::min
 #include "gcontext.h"	
 
+/*
+ * Constructor - starts with an empty pixel buffer
+ */
+GraphicsContext::GraphicsContext()
+{
+	pixelCount = 0;
+	run = false;
+}
+
 /*
  * Destructor - does nothing
  */
@@ -32,8 +41,12 @@ GraphicsContext::~GraphicsContext()
  */
 void GraphicsContext::drawLine(int x0, int y0, int x1, int y1)
 {
+	if(!clipLine(x0,y0,x1,y1,getWindowWidth(),getWindowHeight())){
+		return;
+	}
+
 	if(isHorizontal(x0,y0,x1,y1)){
-		drawHorizontalLine(x0,x1,y0);
+		fillSpan(y0,x0,x1);
 	}else if(isVertical(x0,y0,x1,y1)){
 		drawVerticalLine(y0,y1,x0);
 	}else{
@@ -67,6 +80,7 @@ void GraphicsContext::drawLine(int x0, int y0, int x1, int y1)
 		}
 	}
 
+	flushPixels();
 	return;
 }
 
@@ -90,14 +104,14 @@ void GraphicsContext::drawCircle(int x0, int y0, unsigned int radius)
 	int err = dx - (radius << 1);
 
 	while(x >= y){
-		setPixel(x0 + x, y0 + y);
-        setPixel(x0 + y, y0 + x);
-        setPixel(x0 - y, y0 + x);
-        setPixel(x0 - x, y0 + y);
-        setPixel(x0 - x, y0 - y);
-        setPixel(x0 - y, y0 - x);
-        setPixel(x0 + y, y0 - x);
-        setPixel(x0 + x, y0 - y);
+		bufferPixel(x0 + x, y0 + y);
+        bufferPixel(x0 + y, y0 + x);
+        bufferPixel(x0 - y, y0 + x);
+        bufferPixel(x0 - x, y0 + y);
+        bufferPixel(x0 - x, y0 - y);
+        bufferPixel(x0 - y, y0 - x);
+        bufferPixel(x0 + y, y0 - x);
+        bufferPixel(x0 + x, y0 - y);
 	
 
 		if(err <= 0){
@@ -111,14 +125,280 @@ void GraphicsContext::drawCircle(int x0, int y0, unsigned int radius)
 		}
 	}
 	
+	flushPixels();
 	return;	
 }
 
+/* Sets every pixel of a horizontal run, one setPixel at a time.
+ * 
+ * Parameters:
+ * 	y - row of the span
+ *  x0, x1 - first and last column, in either order
+ * 
+ * Returns: void
+ */
+void GraphicsContext::fillSpan(int y, int x0, int x1)
+{
+	drawHorizontalLine(x0,x1,y);
+	flushPixels();
+}
+
+/* Draws each line with drawLine.
+ * 
+ * Parameters:
+ * 	segments - the lines to draw
+ *  n - number of lines
+ * 
+ * Returns: void
+ */
+void GraphicsContext::drawLines(const Segment* segments, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; i++){
+		drawLine(segments[i].x0, segments[i].y0, segments[i].x1, segments[i].y1);
+	}
+}
+
+/* Sets each pixel with setPixel.
+ * 
+ * Parameters:
+ * 	points - the pixels to set
+ *  n - number of pixels
+ * 
+ * Returns: void
+ */
+void GraphicsContext::setPixels(const Point* points, unsigned int n)
+{
+	for(unsigned int i = 0; i < n; i++){
+		setPixel(points[i].x, points[i].y);
+	}
+}
+
+/* Draws the outline of the triangle with drawLines, since there is no
+ * depth buffer to fill it against.
+ * 
+ * Parameters:
+ * 	x, y - device coordinates of the 3 corners
+ *  depth - depth of each corner, unused
+ * 
+ * Returns: void
+ */
+void GraphicsContext::fillTriangle(const float* x, const float* y, const float* depth)
+{
+	Segment edges[3];
+	unsigned int count = 0;
+	for(int i = 0; i < 3; i++){
+		if(toSegment(x[i], y[i], x[(i + 1) % 3], y[(i + 1) % 3], edges[count])){
+			count++;
+		}
+	}
+	drawLines(edges, count);
+}
+
+/* Marks the start of a frame. Contexts which do not queue drawing
+ * need do nothing.
+ */
+void GraphicsContext::beginFrame()
+{
+}
+
+/* Marks the end of a frame, by which point everything drawn must be
+ * visible. Contexts which do not queue drawing need do nothing.
+ */
+void GraphicsContext::endFrame()
+{
+}
+
 void GraphicsContext::endLoop()
 {
 	run = false;
 }
 
+// Cohen-Sutherland outcodes, one bit per window edge a point is beyond
+static const int CLIP_LEFT = 1;
+static const int CLIP_RIGHT = 2;
+static const int CLIP_TOP = 4;
+static const int CLIP_BOTTOM = 8;
+
+/* This is a helper function which finds the outcode of a point.
+ */
+static inline int outcode(double x, double y, double right, double bottom){
+	int code = 0;
+	if(x < 0){
+		code |= CLIP_LEFT;
+	}else if(x > right){
+		code |= CLIP_RIGHT;
+	}
+	if(y < 0){
+		code |= CLIP_TOP;
+	}else if(y > bottom){
+		code |= CLIP_BOTTOM;
+	}
+	return code;
+}
+
+/* Clips a line to the pixels 0 <= x < width, 0 <= y < height
+ * using the Cohen-Sutherland algorithm, so that only the visible
+ * part is rasterized.  Lines already inside are left untouched.
+ * 
+ * Parameters:
+ * 	x0, y0 - origin of line, moved onto the window if needed
+ *  x1, y1 - end of line, moved onto the window if needed
+ *  width, height - size of the window
+ * 
+ * Returns: false if no part of the line is in the window
+ */
+bool GraphicsContext::clipLine(int& x0, int& y0, int& x1, int& y1, int width, int height){
+	const double right = width - 1;
+	const double bottom = height - 1;
+
+	// intersections are found in floating point so that repeated
+	// clipping does not accumulate rounding
+	double ax = x0, ay = y0, bx = x1, by = y1;
+	int codeA = outcode(ax, ay, right, bottom);
+	int codeB = outcode(bx, by, right, bottom);
+
+	if(!(codeA | codeB)){
+		return true;
+	}
+
+	while(codeA | codeB){
+		if(codeA & codeB){
+			return false;
+		}
+
+		// move whichever end is outside onto the edge it is beyond
+		int code = codeA ? codeA : codeB;
+		double x, y;
+
+		if(code & CLIP_TOP){
+			x = ax + (bx - ax) * (0 - ay) / (by - ay);
+			y = 0;
+		}else if(code & CLIP_BOTTOM){
+			x = ax + (bx - ax) * (bottom - ay) / (by - ay);
+			y = bottom;
+		}else if(code & CLIP_LEFT){
+			y = ay + (by - ay) * (0 - ax) / (bx - ax);
+			x = 0;
+		}else{
+			y = ay + (by - ay) * (right - ax) / (bx - ax);
+			x = right;
+		}
+
+		if(code == codeA){
+			ax = x;
+			ay = y;
+			codeA = outcode(ax, ay, right, bottom);
+		}else{
+			bx = x;
+			by = y;
+			codeB = outcode(bx, by, right, bottom);
+		}
+	}
+
+	// rounding can not leave the window since the edges are whole numbers
+	x0 = std::lround(ax);
+	y0 = std::lround(ay);
+	x1 = std::lround(bx);
+	y1 = std::lround(by);
+	return true;
+}
+
+// half the width of the guard band lines are clipped to before they are
+// converted to ints, far larger than any window
+static const double GUARD_BAND = 1 << 20;
+
+/* Converts a line in floating point device coordinates to a
+ * Segment.  Coordinates far outside the window are first clipped
+ * to a guard band, since converting a float out of the range of
+ * an int is undefined.
+ * 
+ * Parameters:
+ * 	x0, y0 - origin of line
+ *  x1, y1 - end of line
+ *  segment - the converted line
+ * 
+ * Returns: false if the line misses the guard band or is not a number
+ */
+bool GraphicsContext::toSegment(float x0, float y0, float x1, float y1, Segment& segment){
+	if(!std::isfinite(x0) || !std::isfinite(y0) || !std::isfinite(x1) || !std::isfinite(y1)){
+		return false;
+	}
+
+	double ax = x0, ay = y0, bx = x1, by = y1;
+
+	if(std::fabs(ax) > GUARD_BAND || std::fabs(ay) > GUARD_BAND ||
+		std::fabs(bx) > GUARD_BAND || std::fabs(by) > GUARD_BAND){
+		// Liang-Barsky: narrow the parameter range [t0, t1] of the line
+		// to the part inside each edge of the band
+		const double dx = bx - ax;
+		const double dy = by - ay;
+		const double p[4] = {-dx, dx, -dy, dy};
+		const double q[4] = {ax + GUARD_BAND, GUARD_BAND - ax, ay + GUARD_BAND, GUARD_BAND - ay};
+		double t0 = 0, t1 = 1;
+
+		for(int i = 0; i < 4; i++){
+			if(p[i] == 0){
+				if(q[i] < 0){
+					return false;
+				}
+			}else{
+				const double t = q[i] / p[i];
+				if(p[i] < 0){
+					t0 = std::max(t0, t);
+				}else{
+					t1 = std::min(t1, t);
+				}
+			}
+		}
+		if(t0 > t1){
+			return false;
+		}
+
+		bx = ax + t1 * dx;
+		by = ay + t1 * dy;
+		ax = ax + t0 * dx;
+		ay = ay + t0 * dy;
+	}
+
+	segment.x0 = (int)ax;
+	segment.y0 = (int)ay;
+	segment.x1 = (int)bx;
+	segment.y1 = (int)by;
+	return true;
+}
+
+/* This is a helper function which adds a pixel to the pixel buffer,
+ * passing the buffer to setPixels when it is full.
+ * 
+ * Parameters:
+ * 	x, y - pixel to set
+ * 
+ * Returns: void
+ */
+void GraphicsContext::bufferPixel(int x, int y){
+	if(pixelCount == PIXEL_BUFFER_SIZE){
+		flushPixels();
+	}
+	pixelBuffer[pixelCount].x = x;
+	pixelBuffer[pixelCount].y = y;
+	pixelCount++;
+}
+
+/* This is a helper function which passes any buffered pixels to
+ * setPixels.
+ * 
+ * Parameters:
+ * 	none
+ * 
+ * Returns: void
+ */
+void GraphicsContext::flushPixels(){
+	if(pixelCount > 0){
+		setPixels(pixelBuffer, pixelCount);
+		pixelCount = 0;
+	}
+}
+
 /* This is a helper function which tests if a line is vertical
  * 
  * Parameters:
@@ -156,11 +436,11 @@ bool GraphicsContext::isHorizontal(int x0, int y0, int x1, int y1){
 void GraphicsContext::drawVerticalLine(int y0, int y1, int x){
 	if(y0 <= y1){
 		for(int y = y0; y <= y1; y++){
-			setPixel(x,y);
+			bufferPixel(x,y);
 		}
 	}else{
 		for(int y = y0; y >= y1; y--){
-			setPixel(x,y);
+			bufferPixel(x,y);
 		}
 	}
 }
@@ -178,11 +458,11 @@ void GraphicsContext::drawVerticalLine(int y0, int y1, int x){
 void GraphicsContext::drawHorizontalLine(int x0, int x1, int y){
 	if(x0 <= x1){
 		for(int x = x0; x <= x1; x++){
-			setPixel(x,y);
+			bufferPixel(x,y);
 		}
 	}else{
 		for(int x = x0; x >= x1; x--){
-			setPixel(x,y);
+			bufferPixel(x,y);
 		}
 	}
 }
@@ -203,7 +483,7 @@ void GraphicsContext::drawOctantOne(int x0, int y0, int x1, int y1){
 	int err = 0;
 
 	for(int x = x0; x <= x1; x++){
-		setPixel(x,y);
+		bufferPixel(x,y);
 		err = err + dy;
 		if((err << 1) >= dx){
 			y = y + 1;
@@ -228,7 +508,7 @@ void GraphicsContext::drawOctantTwo(int x0, int y0, int x1, int y1){
 	int err = 0;
 
 	for(int y = y0; y <= y1; y++){
-		setPixel(x,y);
+		bufferPixel(x,y);
 		err = err + dx;
 		if((err << 1) >= dy){
 			x = x + 1;
@@ -253,7 +533,7 @@ void GraphicsContext::drawOctantEight(int x0, int y0, int x1, int y1){
 	int err = 0;
 
 	for(int x = x0; x <= x1; x++){
-		setPixel(x,y);
+		bufferPixel(x,y);
 		err = err + dy;
 		if((err << 1) <= dx){
 			y = y - 1;
@@ -278,7 +558,7 @@ void GraphicsContext::drawOctantThree(int x0, int y0, int x1, int y1){
 	int err = 0;
 
 	for(int y = y0; y <= y1; y++){
-		setPixel(x,y);
+		bufferPixel(x,y);
 		err = err + dx;
 		if((err << 1) <= dy){
 			x = x - 1;
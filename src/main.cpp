@@ -9,40 +9,99 @@
 #include <unistd.h>
 #include <fstream>
 #include <fenv.h>
+#include <chrono>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <string>
 
 #include "MyDrawing.h"
 #include "ViewContext.h"
 #include "x11context.h"
+#include "fbcontext.h"
 #include "Triangle.h"
 #include "Image.h"
+#include "matrix_kernels.h"
 
 static GraphicsContext* gc;
 static ViewContext* vc;
 
-static void initialize();
+static void initialize(const char* script, bool software, unsigned int threads);
 static void demo();
 
 /* 
- * This is a driver for testing the Shapes functionality
+ * This is a driver for testing the Shapes functionality. Given a script file, the
+ * drawing is rendered off screen with the events in the script instead of in a
+ * window, and the time taken is reported. Otherwise it is drawn in a window by the
+ * X server, or in process memory when --software is given.
  * 
  * Parameters:
- * 	none
+ * 	argv[1] - optional event script for headless rendering, see FramebufferContext,
+ *            or --software to render the window in software
+ *  argv[2] - optional number of threads filling triangles in headless rendering
  * 
  * Returns:
  *  0 if successful
  */
-int main(){
+int main(int argc, char** argv){
 
-    initialize();
+    const bool software = argc > 1 && std::string(argv[1]) == "--software";
+    const char* script = argc > 1 && !software ? argv[1] : nullptr;
+
+    unsigned int threads = 0;
+    if(argc > 2){
+        // a count that is not a positive number is rejected rather than
+        // wrapping around to billions of threads
+        char* end;
+        errno = 0;
+        const unsigned long parsed = std::strtoul(argv[2], &end, 10);
+        if(argv[2][0] == '-' || *end != '\0' || end == argv[2] || errno == ERANGE || parsed == 0){
+            std::cerr << "thread count must be a positive number, not " << argv[2] << std::endl;
+            return 1;
+        }
+        threads = parsed > UINT_MAX ? UINT_MAX : parsed;
+    }
+
+    initialize(script, software, threads);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     demo();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if(script){
+        std::cerr << "script ran in " << elapsed.count() * 1000 << " ms using the "
+                  << matrixKernelName() << " matrix kernels" << std::endl;
+    }
 
     delete gc;
     delete vc;
     return 0;
 }
 
-static void initialize(){
-    gc = new X11Context(800,600,GraphicsContext::BLACK);
+static void initialize(const char* script, bool software, unsigned int threads){
+    if(script){
+        FramebufferContext* fb = new FramebufferContext(800,600,GraphicsContext::BLACK);
+        if(threads > 0){
+            fb->setThreadCount(threads);
+        }
+        std::ifstream file(script);
+
+        if(!file){
+            std::cerr << "could not open " << script << std::endl;
+        }else if(!fb->loadScript(file)){
+            std::cerr << "ignored unrecognized lines in " << script << std::endl;
+        }
+        gc = fb;
+    }else{
+        X11Context* x11 = new X11Context(800,600,GraphicsContext::BLACK);
+        if(!software || !x11->setSoftwareRendering(true)){
+            if(software){
+                std::cerr << "software rendering needs a 32-bit RGB display" << std::endl;
+            }
+            x11->setBackBuffer(true);
+        }
+        gc = x11;
+    }
     vc = new ViewContext(50,50,0,gc->getWindowWidth()/2,gc->getWindowWidth()/2,1000);
 }
 
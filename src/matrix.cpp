@@ -6,8 +6,10 @@
  */
 
 #include "matrix.h"
+#include "matrix_kernels.h"
 #include <string>
 #include <cmath>
+#include <algorithm>
 
 /**
  * Parameterized contstuctor
@@ -38,20 +40,25 @@ matrix::matrix(unsigned int rows, unsigned int cols) : rows(rows), cols(cols)
  **/
 matrix::matrix(const matrix &from) : rows(from.rows), cols(from.cols)
 {
-	the_matrix = new double*[rows];
-
-	for (unsigned int i = 0; i < rows; i++)
-	{
-		the_matrix[i] = new double[cols];
-
-		for (unsigned int j = 0; j < cols; j++)
-		{
-			the_matrix[i][j] = from[i][j];
-		}
-	}
+	the_matrix = new double[rows * cols];
+	std::copy(from.the_matrix, from.the_matrix + rows * cols, the_matrix);
+}
 
-	this->rows = rows;
-	this->cols = cols;
+/**
+ * Move contstuctor. Takes ownership of the storage of an expiring
+ * matrix rather than copying it. The source is left as an empty
+ * 0x0 matrix which may only be destroyed or assigned to.
+ * Input:
+ *      from - rvalue reference to matrix to move from
+ * Output:
+ *      new matrix object
+ **/
+matrix::matrix(matrix &&from) noexcept
+	: the_matrix(from.the_matrix), rows(from.rows), cols(from.cols)
+{
+	from.the_matrix = nullptr;
+	from.rows = 0;
+	from.cols = 0;
 }
 
 /**
@@ -78,31 +85,44 @@ matrix::~matrix()
  **/
 matrix &matrix::operator=(const matrix &rhs)
 {
-	if (this->rows != rhs.rows || this->cols != rhs.cols)
+	if (this == &rhs)
+	{
+		return *this;
+	}
+
+	if (this->rows * this->cols != rhs.rows * rhs.cols)
 	{
 		erase();
-		the_matrix = new double*[rhs.rows];
+		the_matrix = new double[rhs.rows * rhs.cols];
+	}
 
-		for (unsigned int i = 0; i < rhs.rows; i++)
-		{
-			the_matrix[i] =  new double[rhs.cols];
+	this->rows = rhs.rows;
+	this->cols = rhs.cols;
+	std::copy(rhs.the_matrix, rhs.the_matrix + rows * cols, the_matrix);
 
-			for (unsigned int j = 0; j < rhs.cols; j++)
-			{
-				the_matrix[i][j] = rhs[i][j];
-			}
-		}
+	return *this;
+}
 
-		this->rows = rhs.rows;
-		this->cols = rhs.cols;
-	} else {
-		for (unsigned int i = 0; i < rows; i++)
-		{
-			for (unsigned int j = 0; j < cols; j++)
-			{
-				the_matrix[i][j] = rhs[i][j];
-			}
-		}
+/**
+ * Move assignment. Releases the storage held by "this" and takes
+ * ownership of the storage of rhs. rhs is left as an empty 0x0 matrix.
+ * Input:
+ *      rhs - rvalue reference to matrix to move into "this"
+ * Output:
+ *      *this - refers to reassigned matrix object
+ **/
+matrix &matrix::operator=(matrix &&rhs) noexcept
+{
+	if (this != &rhs)
+	{
+		erase();
+		the_matrix = rhs.the_matrix;
+		rows = rhs.rows;
+		cols = rhs.cols;
+
+		rhs.the_matrix = nullptr;
+		rhs.rows = 0;
+		rhs.cols = 0;
 	}
 
 	return *this;
@@ -124,7 +144,7 @@ matrix matrix::identity(unsigned int size)
 	matrix identity = matrix(size, size);
 	for (unsigned int i = 0; i < size; i++)
 	{
-		identity[i][i] = 1.0;
+		identity.the_matrix[i * size + i] = 1.0;
 	}
 	return identity;
 }
@@ -145,14 +165,12 @@ matrix matrix::operator+(const matrix &rhs) const
 		throw matrixException("Matrixies must have the same number of rows and columns");
 	}
 
-	matrix tempMatrix = *this;
+	matrix tempMatrix = matrix(rows, cols);
+	const unsigned int size = rows * cols;
 
-	for (unsigned int i = 0; i < this->rows; i++)
+	for (unsigned int i = 0; i < size; i++)
 	{
-		for (unsigned int j = 0; j < this->cols; j++)
-		{
-			tempMatrix[i][j] = the_matrix[i][j] + rhs[i][j];
-		}
+		tempMatrix.the_matrix[i] = the_matrix[i] + rhs.the_matrix[i];
 	}
 
 	return tempMatrix;
@@ -177,17 +195,37 @@ matrix matrix::operator*(const matrix &rhs) const
 	}
 
 	matrix tempMatrix = matrix(this->rows, rhs.cols);
+	double* out = tempMatrix.the_matrix;
+
+	// 4x4 by 4xN is the transform pipeline's shape - use the vectorized kernels
+	if (this->rows == 4 && this->cols == 4)
+	{
+		if (rhs.cols == 4)
+		{
+			mat4Multiply(the_matrix, rhs.the_matrix, out);
+		}
+		else
+		{
+			mat4MultiplyN(the_matrix, rhs.the_matrix, out, rhs.cols);
+		}
+		return tempMatrix;
+	}
 
+	// i-k-j ordering walks both rhs and the result along contiguous rows
 	for (unsigned int i = 0; i < this->rows; i++)
 	{
-		for (unsigned int j = 0; j < rhs.cols; j++)
+		double* outRow = out + i * rhs.cols;
+		const double* lhsRow = the_matrix + i * this->cols;
+
+		for (unsigned int k = 0; k < this->cols; k++)
 		{
-			double result = 0;
-			for (unsigned int k = 0; k < this->cols; k++)
+			const double a = lhsRow[k];
+			const double* rhsRow = rhs.the_matrix + k * rhs.cols;
+
+			for (unsigned int j = 0; j < rhs.cols; j++)
 			{
-				result += (the_matrix[i])[k] * rhs[k][j];
+				outRow[j] += a * rhsRow[j];
 			}
-			tempMatrix[i][j] = result;
 		}
 	}
 
@@ -204,14 +242,12 @@ matrix matrix::operator*(const matrix &rhs) const
  **/
 matrix matrix::operator*(const double scale) const
 {
-	matrix tempMatrix = *this;
+	matrix tempMatrix = matrix(rows, cols);
+	const unsigned int size = rows * cols;
 
-	for (unsigned int i = 0; i < rows; i++)
+	for (unsigned int i = 0; i < size; i++)
 	{
-		for (unsigned int j = 0; j < cols; j++)
-		{
-			tempMatrix[i][j] = scale * (the_matrix[i])[j];
-		}
+		tempMatrix.the_matrix[i] = scale * the_matrix[i];
 	}
 
 	return tempMatrix;
@@ -233,7 +269,7 @@ matrix matrix::operator~() const
 	{
 		for (unsigned int j = 0; j < cols; j++)
 		{
-			tempMatrix[j][i] = the_matrix[i][j];
+			tempMatrix.the_matrix[j * rows + i] = the_matrix[i * cols + j];
 		}
 	}
 
@@ -249,17 +285,35 @@ matrix matrix::operator~() const
  **/
 void matrix::clear()
 {
-	for (unsigned int i = 0; i < rows; i++)
-	{
-		for (unsigned int j = 0; j < cols; j++)
-		{
-			the_matrix[i][j] = 0.0;
-		}
-	}
+	std::fill(the_matrix, the_matrix + rows * cols, 0.0);
 
 	return;
 }
 
+/**
+ * Returns the number of rows in the matrix.
+ * Input:
+ *      none
+ * Output:
+ *      number of rows
+ **/
+unsigned int matrix::getRows() const
+{
+	return rows;
+}
+
+/**
+ * Returns the number of columns in the matrix.
+ * Input:
+ *      none
+ * Output:
+ *      number of columns
+ **/
+unsigned int matrix::getCols() const
+{
+	return cols;
+}
+
 /**
  * Access operator that allows a row to be accessed from the matrix. 
  * Includes index access protection.
@@ -272,11 +326,11 @@ void matrix::clear()
  **/
 matrix::matrix_row matrix::operator[](unsigned int row)
 {
-	if (row > rows - 1)
+	if (row >= rows)
 	{
 		throw matrixException("Attempting to access a matrix row that does not exist.");
 	}
-	matrix_row mrow = matrix_row(the_matrix[row], cols);
+	matrix_row mrow = matrix_row(the_matrix + row * cols, cols);
 	return mrow;
 }
 
@@ -292,11 +346,11 @@ matrix::matrix_row matrix::operator[](unsigned int row)
  **/
 matrix::matrix_row matrix::operator[](unsigned int row) const
 {
-	if (row > rows - 1)
+	if (row >= rows)
 	{
 		throw matrixException("Attempting to access a matrix row that does not exist.");
 	}
-	matrix_row mrow = matrix_row(the_matrix[row], cols);
+	matrix_row mrow = matrix_row(the_matrix + row * cols, cols);
 	return mrow;
 }
 
@@ -313,7 +367,7 @@ std::ostream &matrix::out(std::ostream &os) const
 	{
 		for (unsigned int j = 0; j < cols; j++)
 		{
-			os << " " << (the_matrix[i])[j] << " ";
+			os << " " << the_matrix[i * cols + j] << " ";
 		}
 		os << std::endl;
 	}
@@ -334,12 +388,8 @@ std::ostream &matrix::out(std::ostream &os) const
  **/
 void matrix::erase()
 {
-	for (unsigned int i = 0; i < rows; i++)
-	{
-		delete[] the_matrix[i];
-	}
-
 	delete[] the_matrix;
+	the_matrix = nullptr;
 	rows = 0;
 	cols = 0;
 }
@@ -361,17 +411,8 @@ void matrix::createEmptyMatrix(int rows, int cols)
 		throw matrixException("p-constructor bad arguments");
 	}
 
-	the_matrix = new double*[rows];
-
-	for (int i = 0; i < rows; i++)
-	{
-		the_matrix[i] = new double[cols];
-
-		for (int j = 0; j < cols; j++)
-		{
-			the_matrix[i][j] = 0.0;
-		}
-	}
+	// value-initialization zeroes the whole buffer in one allocation
+	the_matrix = new double[rows * cols]();
 
 	this->rows = rows;
 	this->cols = cols;
@@ -405,7 +446,7 @@ matrix::matrix_row::matrix_row(double* row, unsigned int cols){
  **/
 double& matrix::matrix_row::operator[](unsigned int col)
 {
-	if (col > cols - 1)
+	if (col >= cols)
 	{
 		throw matrixException("Error attempting to access column outside of matrix row.");
 	}
@@ -424,7 +465,7 @@ double& matrix::matrix_row::operator[](unsigned int col)
  **/
 double& matrix::matrix_row::operator[](unsigned int col) const
 {
-	if (col > cols - 1)
+	if (col >= cols)
 	{
 		throw matrixException("Error attempting to access column outside of matrix row.");
 	}
@@ -0,0 +1,432 @@
+/**
+ * matrix_kernels.cpp - Implementation of the 4x4 product kernels and the cpuid
+ * based dispatch between them.
+ */
+
+#include "matrix_kernels.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MATRIX_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+// a kernel set - one entry per supported product shape
+struct MatrixKernels {
+    const char* name;
+    void (*mul4x4)(const double* a, const double* b, double* out);
+    void (*mul4xN)(const double* a, const double* b, double* out, unsigned int n);
+    void (*transform)(const double* m, const float* x, const float* y, const float* z, unsigned int n,
+                      float* outX, float* outY, float* outZ);
+};
+
+/////////////////////////////////////////////////
+// Scalar kernels
+/////////////////////////////////////////////////
+
+/**
+ * Portable helper computing columns [first, n) of a 4xN product.
+ * Input:
+ *      a - 4x4 left hand side
+ *      b - 4xN right hand side
+ *      out - 4xN result
+ *      n - number of columns
+ *      first - first column to compute
+ * Output:
+ *      none
+ */
+static void mulColumnsScalar(const double* a, const double* b, double* out, unsigned int n, unsigned int first){
+    for(unsigned int i = 0; i < 4; i++){
+        const double a0 = a[i * 4 + 0];
+        const double a1 = a[i * 4 + 1];
+        const double a2 = a[i * 4 + 2];
+        const double a3 = a[i * 4 + 3];
+        double* o = out + i * n;
+
+        for(unsigned int j = first; j < n; j++){
+            o[j] = a0 * b[j] + a1 * b[n + j] + a2 * b[2 * n + j] + a3 * b[3 * n + j];
+        }
+    }
+}
+
+static void mul4xNScalar(const double* a, const double* b, double* out, unsigned int n){
+    mulColumnsScalar(a, b, out, n, 0);
+}
+
+static void mul4x4Scalar(const double* a, const double* b, double* out){
+    mulColumnsScalar(a, b, out, 4, 0);
+}
+
+/**
+ * Portable helper transforming points [first, n) by the top three rows of a 4x4
+ * matrix. Every kernel set sums the terms in this order without fusing them, so
+ * all of them give the same results.
+ * Input:
+ *      m - 4x4 transform
+ *      x, y, z - coordinates of the points, n entries each
+ *      n - number of points
+ *      outX, outY, outZ - n entries receiving the transformed coordinates
+ *      first - first point to transform
+ * Output:
+ *      none
+ */
+static void transformRangeScalar(const double* m, const float* x, const float* y, const float* z, unsigned int n,
+                                 float* outX, float* outY, float* outZ, unsigned int first){
+    for(unsigned int i = first; i < n; i++){
+        const double px = x[i], py = y[i], pz = z[i];
+        outX[i] = m[0] * px + m[1] * py + m[2] * pz + m[3];
+        outY[i] = m[4] * px + m[5] * py + m[6] * pz + m[7];
+        outZ[i] = m[8] * px + m[9] * py + m[10] * pz + m[11];
+    }
+}
+
+static void transformScalar(const double* m, const float* x, const float* y, const float* z, unsigned int n,
+                            float* outX, float* outY, float* outZ){
+    transformRangeScalar(m, x, y, z, n, outX, outY, outZ, 0);
+}
+
+#ifdef MATRIX_KERNELS_X86
+
+/////////////////////////////////////////////////
+// SSE2 kernels - two doubles per register
+/////////////////////////////////////////////////
+
+__attribute__((target("sse2")))
+static void mul4xNSSE2(const double* a, const double* b, double* out, unsigned int n){
+    const unsigned int vectorEnd = n & ~1u;
+
+    for(unsigned int i = 0; i < 4; i++){
+        const __m128d a0 = _mm_set1_pd(a[i * 4 + 0]);
+        const __m128d a1 = _mm_set1_pd(a[i * 4 + 1]);
+        const __m128d a2 = _mm_set1_pd(a[i * 4 + 2]);
+        const __m128d a3 = _mm_set1_pd(a[i * 4 + 3]);
+        double* o = out + i * n;
+
+        for(unsigned int j = 0; j < vectorEnd; j += 2){
+            __m128d r = _mm_mul_pd(a0, _mm_loadu_pd(b + j));
+            r = _mm_add_pd(r, _mm_mul_pd(a1, _mm_loadu_pd(b + n + j)));
+            r = _mm_add_pd(r, _mm_mul_pd(a2, _mm_loadu_pd(b + 2 * n + j)));
+            r = _mm_add_pd(r, _mm_mul_pd(a3, _mm_loadu_pd(b + 3 * n + j)));
+            _mm_storeu_pd(o + j, r);
+        }
+    }
+
+    if(vectorEnd != n){
+        mulColumnsScalar(a, b, out, n, vectorEnd);
+    }
+}
+
+__attribute__((target("sse2")))
+static void mul4x4SSE2(const double* a, const double* b, double* out){
+    const __m128d b0lo = _mm_loadu_pd(b + 0),  b0hi = _mm_loadu_pd(b + 2);
+    const __m128d b1lo = _mm_loadu_pd(b + 4),  b1hi = _mm_loadu_pd(b + 6);
+    const __m128d b2lo = _mm_loadu_pd(b + 8),  b2hi = _mm_loadu_pd(b + 10);
+    const __m128d b3lo = _mm_loadu_pd(b + 12), b3hi = _mm_loadu_pd(b + 14);
+
+    for(unsigned int i = 0; i < 4; i++){
+        const __m128d a0 = _mm_set1_pd(a[i * 4 + 0]);
+        const __m128d a1 = _mm_set1_pd(a[i * 4 + 1]);
+        const __m128d a2 = _mm_set1_pd(a[i * 4 + 2]);
+        const __m128d a3 = _mm_set1_pd(a[i * 4 + 3]);
+
+        __m128d lo = _mm_mul_pd(a0, b0lo);
+        __m128d hi = _mm_mul_pd(a0, b0hi);
+        lo = _mm_add_pd(lo, _mm_mul_pd(a1, b1lo));
+        hi = _mm_add_pd(hi, _mm_mul_pd(a1, b1hi));
+        lo = _mm_add_pd(lo, _mm_mul_pd(a2, b2lo));
+        hi = _mm_add_pd(hi, _mm_mul_pd(a2, b2hi));
+        lo = _mm_add_pd(lo, _mm_mul_pd(a3, b3lo));
+        hi = _mm_add_pd(hi, _mm_mul_pd(a3, b3hi));
+
+        _mm_storeu_pd(out + i * 4, lo);
+        _mm_storeu_pd(out + i * 4 + 2, hi);
+    }
+}
+
+__attribute__((target("sse2")))
+static void transformSSE2(const double* m, const float* x, const float* y, const float* z, unsigned int n,
+                          float* outX, float* outY, float* outZ){
+    const unsigned int vectorEnd = n & ~1u;
+    float* out[3] = {outX, outY, outZ};
+
+    for(unsigned int i = 0; i < vectorEnd; i += 2){
+        const __m128d px = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(x + i))));
+        const __m128d py = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + i))));
+        const __m128d pz = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(z + i))));
+
+        for(unsigned int r = 0; r < 3; r++){
+            __m128d v = _mm_mul_pd(_mm_set1_pd(m[r * 4]), px);
+            v = _mm_add_pd(v, _mm_mul_pd(_mm_set1_pd(m[r * 4 + 1]), py));
+            v = _mm_add_pd(v, _mm_mul_pd(_mm_set1_pd(m[r * 4 + 2]), pz));
+            v = _mm_add_pd(v, _mm_set1_pd(m[r * 4 + 3]));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out[r] + i), _mm_castps_si128(_mm_cvtpd_ps(v)));
+        }
+    }
+
+    if(vectorEnd != n){
+        transformRangeScalar(m, x, y, z, n, outX, outY, outZ, vectorEnd);
+    }
+}
+
+/////////////////////////////////////////////////
+// AVX2 kernels - four doubles per register, fused multiply-add
+/////////////////////////////////////////////////
+
+__attribute__((target("avx2,fma")))
+static void mul4xNAVX2(const double* a, const double* b, double* out, unsigned int n){
+    const unsigned int vectorEnd = n & ~3u;
+
+    for(unsigned int i = 0; i < 4; i++){
+        const __m256d a0 = _mm256_set1_pd(a[i * 4 + 0]);
+        const __m256d a1 = _mm256_set1_pd(a[i * 4 + 1]);
+        const __m256d a2 = _mm256_set1_pd(a[i * 4 + 2]);
+        const __m256d a3 = _mm256_set1_pd(a[i * 4 + 3]);
+        double* o = out + i * n;
+
+        for(unsigned int j = 0; j < vectorEnd; j += 4){
+            __m256d r = _mm256_mul_pd(a0, _mm256_loadu_pd(b + j));
+            r = _mm256_fmadd_pd(a1, _mm256_loadu_pd(b + n + j), r);
+            r = _mm256_fmadd_pd(a2, _mm256_loadu_pd(b + 2 * n + j), r);
+            r = _mm256_fmadd_pd(a3, _mm256_loadu_pd(b + 3 * n + j), r);
+            _mm256_storeu_pd(o + j, r);
+        }
+    }
+
+    if(vectorEnd != n){
+        mulColumnsScalar(a, b, out, n, vectorEnd);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void mul4x4AVX2(const double* a, const double* b, double* out){
+    const __m256d b0 = _mm256_loadu_pd(b + 0);
+    const __m256d b1 = _mm256_loadu_pd(b + 4);
+    const __m256d b2 = _mm256_loadu_pd(b + 8);
+    const __m256d b3 = _mm256_loadu_pd(b + 12);
+
+    for(unsigned int i = 0; i < 4; i++){
+        __m256d r = _mm256_mul_pd(_mm256_set1_pd(a[i * 4 + 0]), b0);
+        r = _mm256_fmadd_pd(_mm256_set1_pd(a[i * 4 + 1]), b1, r);
+        r = _mm256_fmadd_pd(_mm256_set1_pd(a[i * 4 + 2]), b2, r);
+        r = _mm256_fmadd_pd(_mm256_set1_pd(a[i * 4 + 3]), b3, r);
+        _mm256_storeu_pd(out + i * 4, r);
+    }
+}
+
+// points are summed without fused multiply-add to match the other kernel sets
+__attribute__((target("avx2")))
+static void transformAVX2(const double* m, const float* x, const float* y, const float* z, unsigned int n,
+                          float* outX, float* outY, float* outZ){
+    const unsigned int vectorEnd = n & ~3u;
+    float* out[3] = {outX, outY, outZ};
+
+    for(unsigned int i = 0; i < vectorEnd; i += 4){
+        const __m256d px = _mm256_cvtps_pd(_mm_loadu_ps(x + i));
+        const __m256d py = _mm256_cvtps_pd(_mm_loadu_ps(y + i));
+        const __m256d pz = _mm256_cvtps_pd(_mm_loadu_ps(z + i));
+
+        for(unsigned int r = 0; r < 3; r++){
+            __m256d v = _mm256_mul_pd(_mm256_set1_pd(m[r * 4]), px);
+            v = _mm256_add_pd(v, _mm256_mul_pd(_mm256_set1_pd(m[r * 4 + 1]), py));
+            v = _mm256_add_pd(v, _mm256_mul_pd(_mm256_set1_pd(m[r * 4 + 2]), pz));
+            v = _mm256_add_pd(v, _mm256_set1_pd(m[r * 4 + 3]));
+            _mm_storeu_ps(out[r] + i, _mm256_cvtpd_ps(v));
+        }
+    }
+
+    if(vectorEnd != n){
+        transformRangeScalar(m, x, y, z, n, outX, outY, outZ, vectorEnd);
+    }
+}
+
+/////////////////////////////////////////////////
+// AVX-512 kernels - eight doubles per register, masked tails
+/////////////////////////////////////////////////
+
+__attribute__((target("avx512f")))
+static void mul4xNAVX512(const double* a, const double* b, double* out, unsigned int n){
+    for(unsigned int i = 0; i < 4; i++){
+        const __m512d a0 = _mm512_set1_pd(a[i * 4 + 0]);
+        const __m512d a1 = _mm512_set1_pd(a[i * 4 + 1]);
+        const __m512d a2 = _mm512_set1_pd(a[i * 4 + 2]);
+        const __m512d a3 = _mm512_set1_pd(a[i * 4 + 3]);
+        double* o = out + i * n;
+
+        for(unsigned int j = 0; j < n; j += 8){
+            const unsigned int remaining = n - j;
+            const __mmask8 mask = remaining >= 8 ? 0xFF : (__mmask8)((1u << remaining) - 1);
+
+            __m512d r = _mm512_mul_pd(a0, _mm512_maskz_loadu_pd(mask, b + j));
+            r = _mm512_fmadd_pd(a1, _mm512_maskz_loadu_pd(mask, b + n + j), r);
+            r = _mm512_fmadd_pd(a2, _mm512_maskz_loadu_pd(mask, b + 2 * n + j), r);
+            r = _mm512_fmadd_pd(a3, _mm512_maskz_loadu_pd(mask, b + 3 * n + j), r);
+            _mm512_mask_storeu_pd(o + j, mask, r);
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+static void mul4x4AVX512(const double* a, const double* b, double* out){
+    // each row of b is repeated in both halves so two output rows are
+    // produced per register
+    const __m512d zero = _mm512_setzero_pd();
+    const __m512d b0 = _mm512_mask_broadcast_f64x4(zero, 0xFF, _mm256_loadu_pd(b + 0));
+    const __m512d b1 = _mm512_mask_broadcast_f64x4(zero, 0xFF, _mm256_loadu_pd(b + 4));
+    const __m512d b2 = _mm512_mask_broadcast_f64x4(zero, 0xFF, _mm256_loadu_pd(b + 8));
+    const __m512d b3 = _mm512_mask_broadcast_f64x4(zero, 0xFF, _mm256_loadu_pd(b + 12));
+
+    for(unsigned int i = 0; i < 4; i += 2){
+        const double* upper = a + i * 4;
+        const double* lower = a + (i + 1) * 4;
+
+        __m512d r = _mm512_mul_pd(_mm512_mask_blend_pd(0xF0, _mm512_set1_pd(upper[0]), _mm512_set1_pd(lower[0])), b0);
+        r = _mm512_fmadd_pd(_mm512_mask_blend_pd(0xF0, _mm512_set1_pd(upper[1]), _mm512_set1_pd(lower[1])), b1, r);
+        r = _mm512_fmadd_pd(_mm512_mask_blend_pd(0xF0, _mm512_set1_pd(upper[2]), _mm512_set1_pd(lower[2])), b2, r);
+        r = _mm512_fmadd_pd(_mm512_mask_blend_pd(0xF0, _mm512_set1_pd(upper[3]), _mm512_set1_pd(lower[3])), b3, r);
+        _mm512_storeu_pd(out + i * 4, r);
+    }
+}
+
+__attribute__((target("avx512f")))
+static void transformAVX512(const double* m, const float* x, const float* y, const float* z, unsigned int n,
+                            float* outX, float* outY, float* outZ){
+    const unsigned int vectorEnd = n & ~7u;
+    float* out[3] = {outX, outY, outZ};
+
+    for(unsigned int i = 0; i < vectorEnd; i += 8){
+        const __m512d px = _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(x + i));
+        const __m512d py = _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(y + i));
+        const __m512d pz = _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(z + i));
+
+        for(unsigned int r = 0; r < 3; r++){
+            __m512d v = _mm512_mul_pd(_mm512_set1_pd(m[r * 4]), px);
+            v = _mm512_add_pd(v, _mm512_mul_pd(_mm512_set1_pd(m[r * 4 + 1]), py));
+            v = _mm512_add_pd(v, _mm512_mul_pd(_mm512_set1_pd(m[r * 4 + 2]), pz));
+            v = _mm512_add_pd(v, _mm512_set1_pd(m[r * 4 + 3]));
+            _mm256_storeu_ps(out[r] + i, _mm512_maskz_cvtpd_ps(0xFF, v));
+        }
+    }
+
+    if(vectorEnd != n){
+        transformRangeScalar(m, x, y, z, n, outX, outY, outZ, vectorEnd);
+    }
+}
+
+#endif
+
+/////////////////////////////////////////////////
+// Dispatch
+/////////////////////////////////////////////////
+
+static const MatrixKernels scalarKernels = {"scalar", mul4x4Scalar, mul4xNScalar, transformScalar};
+#ifdef MATRIX_KERNELS_X86
+static const MatrixKernels sse2Kernels = {"sse2", mul4x4SSE2, mul4xNSSE2, transformSSE2};
+static const MatrixKernels avx2Kernels = {"avx2", mul4x4AVX2, mul4xNAVX2, transformAVX2};
+static const MatrixKernels avx512Kernels = {"avx512", mul4x4AVX512, mul4xNAVX512, transformAVX512};
+#endif
+
+/**
+ * Private helper which queries the CPU (via cpuid) and picks the widest kernel
+ * set it supports, honouring the MATRIX_KERNELS override.
+ * Input:
+ *      none
+ * Output:
+ *      pointer to the selected kernel set
+ */
+static const MatrixKernels* selectKernels(){
+    const char* requested = std::getenv("MATRIX_KERNELS");
+
+    if(requested != nullptr && std::strcmp(requested, "scalar") == 0){
+        return &scalarKernels;
+    }
+
+#ifdef MATRIX_KERNELS_X86
+    __builtin_cpu_init();
+
+    const bool hasAVX512 = __builtin_cpu_supports("avx512f");
+    const bool hasAVX2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    const bool hasSSE2 = __builtin_cpu_supports("sse2");
+
+    if(requested != nullptr){
+        if(std::strcmp(requested, "sse2") == 0 && hasSSE2) return &sse2Kernels;
+        if(std::strcmp(requested, "avx2") == 0 && hasAVX2) return &avx2Kernels;
+        if(std::strcmp(requested, "avx512") == 0 && hasAVX512) return &avx512Kernels;
+    }
+
+    if(hasAVX512) return &avx512Kernels;
+    if(hasAVX2) return &avx2Kernels;
+    if(hasSSE2) return &sse2Kernels;
+#endif
+
+    return &scalarKernels;
+}
+
+// chosen once, before main runs
+static const MatrixKernels* activeKernels = selectKernels();
+
+/**
+ * Private helper returning the active kernel set. Guards against use from other
+ * static initializers that run before activeKernels has been set.
+ */
+static inline const MatrixKernels* kernels(){
+    if(activeKernels == nullptr){
+        activeKernels = selectKernels();
+    }
+    return activeKernels;
+}
+
+/**
+ * Multiplies two 4x4 matricies using the kernel set selected at startup.
+ * Input:
+ *      a - 16 doubles, left hand side
+ *      b - 16 doubles, right hand side
+ *      out - 16 doubles receiving a * b, must not alias a or b
+ * Output:
+ *      none, but contents of out are changed
+ */
+void mat4Multiply(const double* a, const double* b, double* out){
+    kernels()->mul4x4(a, b, out);
+}
+
+/**
+ * Multiplies a 4x4 matrix by a 4xN matrix using the kernel set selected at startup.
+ * Input:
+ *      a - 16 doubles, left hand side
+ *      b - 4*n doubles, right hand side
+ *      out - 4*n doubles receiving a * b, must not alias a or b
+ *      n - number of columns in b and out
+ * Output:
+ *      none, but contents of out are changed
+ */
+void mat4MultiplyN(const double* a, const double* b, double* out, unsigned int n){
+    kernels()->mul4xN(a, b, out, n);
+}
+
+/**
+ * Transforms points by the top three rows of a 4x4 matrix using the kernel set
+ * selected at startup.
+ * Input:
+ *      m - 16 doubles, the transform; the bottom row is not used
+ *      x, y, z - coordinates of the points, n entries each
+ *      n - number of points
+ *      outX, outY, outZ - n entries receiving the transformed coordinates
+ * Output:
+ *      none, but contents of outX, outY and outZ are changed
+ */
+void mat4TransformPoints(const double* m, const float* x, const float* y, const float* z, unsigned int n,
+                         float* outX, float* outY, float* outZ){
+    kernels()->transform(m, x, y, z, n, outX, outY, outZ);
+}
+
+/**
+ * Reports which kernel set was selected at startup.
+ * Input:
+ *      none
+ * Output:
+ *      name of the selected kernel set
+ */
+const char* matrixKernelName(){
+    return kernels()->name;
+}
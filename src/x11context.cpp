@@ -9,6 +9,24 @@
 #include "x11context.h"
 #include "drawbase.h"
 #include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <sys/ipc.h>	// shared memory for MIT-SHM
+#include <sys/shm.h>
+
+// set by trapShmError if attaching shared memory fails
+static bool shmFailed;
+
+/**
+ * Error handler installed while attaching shared memory.  A server on
+ * another machine cannot attach it, and reports that as an error
+ * rather than a return value.
+ * */
+static int trapShmError(Display* display, XErrorEvent* error)
+{
+	shmFailed = true;
+	return 0;
+}
 
 /**
  * The only constructor provided.  Allows size of window and background
@@ -41,6 +59,30 @@ X11Context::X11Context(unsigned int sizex=400,unsigned int sizey=400,
 
 	// Default color to white
 	XSetForeground(display, graphics_context, GraphicsContext::WHITE);
+	color = GraphicsContext::WHITE;
+	background = bg_color;
+	mode = MODE_NORMAL;
+
+	// Draw straight to the window until a back buffer is asked for
+	target = window;
+	backBuffer = None;
+	bufferWidth = bufferHeight = 0;
+	framePresented = false;
+
+	software = NULL;
+	frameImage = NULL;
+	shmAttached = false;
+	shmPending = 0;
+	shmCompletion = XShmQueryExtension(display) ?
+		XShmGetEventBase(display) + ShmCompletion : -1;
+
+	// Nothing queued until a frame begins.  Requests are limited in
+	// size, in 4 byte units: a segment takes two and a point one, after
+	// a three unit header.
+	inFrame = false;
+	lastBatch = 0;
+	maxSegments = (XMaxRequestSize(display) - 3) / 2;
+	maxPoints = XMaxRequestSize(display) - 3;
 
 	// Wait for MapNotify event
 	for(;;) 
@@ -51,8 +93,15 @@ X11Context::X11Context(unsigned int sizex=400,unsigned int sizey=400,
 		break;
 	}
 
-	// We also want exposure, mouse, and keyboard events
-	XSelectInput(display, window, ExposureMask|
+	XWindowAttributes window_attributes;
+	XGetWindowAttributes(display, window, &window_attributes);
+	windowWidth = window_attributes.width;
+	windowHeight = window_attributes.height;
+
+	// We also want exposure, mouse, and keyboard events, and to hear
+	// about changes in size
+	XSelectInput(display, window, StructureNotifyMask|
+								ExposureMask|
 								ButtonPressMask|
 								ButtonReleaseMask|
 								KeyPressMask|
@@ -70,6 +119,9 @@ X11Context::X11Context(unsigned int sizex=400,unsigned int sizey=400,
 // Destructor  - shut down window and connection to server
 X11Context::~X11Context()
 {
+	destroyImage();
+	if (backBuffer != None)
+		XFreePixmap(display, backBuffer);
 	XFreeGC(display, graphics_context);
 	XDestroyWindow(display,window);
 	XCloseDisplay(display);
@@ -78,6 +130,15 @@ X11Context::~X11Context()
 // Set the drawing mode - argument is enumerated
 void X11Context::setMode(drawMode newMode)
 {
+	// queued drawing must be done in the mode it was drawn in
+	if (inFrame)
+		submit();
+
+	mode = newMode;
+
+	if (software)
+		software->setMode(newMode);
+
 	if (newMode == GraphicsContext::MODE_NORMAL)
 	{
 		XSetFunction(display,graphics_context,GXcopy);
@@ -91,22 +152,55 @@ void X11Context::setMode(drawMode newMode)
 // Set drawing color - assume colormap is 24 bit RGB
 void X11Context::setColor(unsigned int color)
 {
+	this->color = color;
+
+	if (software)
+		software->setColor(color);
+
 	// Go ahead and set color here - better performance than setting
-	// on every setPixel 
-    XSetForeground(display, graphics_context, color);
+	// on every setPixel.  Queued drawing sets it per batch instead.
+	if (!inFrame)
+		XSetForeground(display, graphics_context, color);
 }
 
 // Set a pixel in the current color
 void X11Context::setPixel(int x, int y)
 {
-	XDrawPoint(display, window, graphics_context, x, y);
-	XFlush(display);
+	if (software)
+	{
+		softwareTarget()->setPixel(x, y);
+		if (!inFrame)
+			finishImmediate();
+		return;
+	}
+
+	// pixels off the window are dropped, which also keeps them within
+	// the 16 bit coordinates of the protocol
+	if (x < 0 || y < 0 || x >= windowWidth || y >= windowHeight)
+		return;
+
+	if (inFrame)
+	{
+		XPoint point = {(short)x, (short)y};
+		currentBatch().points.push_back(point);
+		return;
+	}
+
+	XDrawPoint(display, target, graphics_context, x, y);
+	finishImmediate();
 }
 
 unsigned int X11Context::getPixel(int x, int y)
 {
+	if (software)
+		return software->getPixel(x, y);
+
+	// the pixel may still be waiting in the queue
+	if (inFrame)
+		submit();
+
 	XImage *image;
-	image = XGetImage (display, window, x, y, 1, 1, AllPlanes, XYPixmap);
+	image = XGetImage (display, target, x, y, 1, 1, AllPlanes, XYPixmap);
 	XColor color;
 	color.pixel = XGetPixel (image, 0, 0);
 	XFree (image);
@@ -123,10 +217,355 @@ unsigned int X11Context::getPixel(int x, int y)
 
 void X11Context::clear()
 {
-	XClearWindow(display, window);
+	if (inFrame)
+	{
+		// anything queued would be erased anyway
+		for (size_t i = 0; i < batches.size(); i++)
+		{
+			batches[i].segments.clear();
+			batches[i].points.clear();
+		}
+	}
+
+	if (software)
+		softwareTarget()->clear();
+	else if (backBuffer != None)
+		clearBackBuffer();
+	else
+		XClearWindow(display, window);
+
+	if (!inFrame)
+		finishImmediate();
+}
+
+// Start queueing drawing for a frame
+void X11Context::beginFrame()
+{
+	inFrame = true;
+
+	if (software)
+		softwareTarget()->beginFrame();
+}
+
+// Send everything queued during the frame and flush once
+void X11Context::endFrame()
+{
+	submit();
+	inFrame = false;
+
+	// filled triangles are rasterized as the framebuffer's frame ends
+	if (software)
+		softwareTarget()->endFrame();
+
+	if (software || backBuffer != None)
+	{
+		present(0, 0, bufferWidth, bufferHeight);
+		framePresented = true;
+	}
+
 	XFlush(display);
 }
 
+// Turns the back buffer on or off
+void X11Context::setBackBuffer(bool enable)
+{
+	if (inFrame)
+		submit();
+
+	if (enable)
+		createBackBuffer();
+	else if (backBuffer != None)
+	{
+		XFreePixmap(display, backBuffer);
+		backBuffer = None;
+		target = window;
+	}
+
+	framePresented = false;
+}
+
+// Turns software rendering on or off
+bool X11Context::setSoftwareRendering(bool enable)
+{
+	if (inFrame)
+		submit();
+
+	framePresented = false;
+
+	if (!enable)
+	{
+		destroyImage();
+
+		// the back buffer takes over again, sized afresh
+		if (backBuffer != None)
+			createBackBuffer();
+		return true;
+	}
+
+	return createImage();
+}
+
+// Creates the software rendering image at the size of the window.  A
+// shared memory image is tried first, then an ordinary one.
+bool X11Context::createImage()
+{
+	destroyImage();
+
+	int screen = DefaultScreen(display);
+	Visual* visual = DefaultVisual(display, screen);
+	int depth = DefaultDepth(display, screen);
+
+	// the framebuffer writes 0x00RRGGBB words in host byte order
+	if (visual->red_mask != 0xFF0000 || visual->green_mask != 0x00FF00 ||
+		visual->blue_mask != 0x0000FF)
+		return false;
+
+	const unsigned int probe = 1;
+	const int hostOrder = *(const char*)&probe ? LSBFirst : MSBFirst;
+
+	unsigned int width = getWindowWidth();
+	unsigned int height = getWindowHeight();
+
+	// the server reads shared memory as it is, so it must agree on order
+	if (XShmQueryExtension(display) && ImageByteOrder(display) == hostOrder)
+	{
+		frameImage = XShmCreateImage(display, visual, depth, ZPixmap, NULL,
+						&shmInfo, width, height);
+
+		if (frameImage && frameImage->bits_per_pixel == 32 &&
+			frameImage->bytes_per_line == (int)width * 4)
+		{
+			shmInfo.shmid = shmget(IPC_PRIVATE, width * height * 4, IPC_CREAT | 0600);
+			shmInfo.shmaddr = shmInfo.shmid < 0 ? (char*)-1 :
+						(char*)shmat(shmInfo.shmid, NULL, 0);
+			shmInfo.readOnly = False;
+
+			if (shmInfo.shmaddr != (char*)-1)
+			{
+				frameImage->data = shmInfo.shmaddr;
+
+				shmFailed = false;
+				int (*previous)(Display*, XErrorEvent*) = XSetErrorHandler(trapShmError);
+				XShmAttach(display, &shmInfo);
+				XSync(display, False);
+				XSetErrorHandler(previous);
+
+				shmAttached = !shmFailed;
+				if (!shmAttached)
+					shmdt(shmInfo.shmaddr);
+			}
+
+			// the segment goes away once both sides have detached
+			if (shmInfo.shmid >= 0)
+				shmctl(shmInfo.shmid, IPC_RMID, NULL);
+		}
+
+		if (frameImage && !shmAttached)
+		{
+			frameImage->data = NULL;
+			XDestroyImage(frameImage);
+			frameImage = NULL;
+		}
+	}
+
+	if (!frameImage)
+	{
+		char* data = (char*)std::malloc(width * height * 4);
+		frameImage = XCreateImage(display, visual, depth, ZPixmap, 0, data,
+						width, height, 32, 0);
+
+		if (!frameImage)
+		{
+			std::free(data);
+			return false;
+		}
+
+		// Xlib converts from host order when the image is sent
+		frameImage->byte_order = hostOrder;
+
+		if (frameImage->bits_per_pixel != 32 ||
+			frameImage->bytes_per_line != (int)width * 4)
+		{
+			XDestroyImage(frameImage);
+			frameImage = NULL;
+			return false;
+		}
+	}
+
+	bufferWidth = width;
+	bufferHeight = height;
+
+	software = new FramebufferContext(width, height, background,
+					(unsigned int*)frameImage->data);
+	software->setColor(color);
+	software->setMode(mode);
+
+	return true;
+}
+
+// Releases the software rendering image
+void X11Context::destroyImage()
+{
+	delete software;
+	software = NULL;
+
+	if (!frameImage)
+		return;
+
+	if (shmAttached)
+	{
+		XShmDetach(display, &shmInfo);
+		XSync(display, False);
+		shmdt(shmInfo.shmaddr);
+		frameImage->data = NULL;
+		shmAttached = false;
+
+		// the server is done with the image, so its completions are
+		// stale and must not be counted against the next one
+		XEvent event;
+		while (XCheckIfEvent(display, &event, isShmCompletion, (XPointer)this))
+			;
+		shmPending = 0;
+	}
+
+	// frees the image data too, unless it was shared
+	XDestroyImage(frameImage);
+	frameImage = NULL;
+}
+
+// Returns the software framebuffer.  The server reads a shared image
+// some time after XShmPutImage returns, so it must be allowed to finish
+// before the memory is drawn over.  It says when with a ShmCompletion
+// event, which is waited for without a round trip.
+FramebufferContext* X11Context::softwareTarget()
+{
+	while (shmPending > 0)
+	{
+		XEvent event;
+		XIfEvent(display, &event, isShmCompletion, (XPointer)this);
+		shmPending--;
+	}
+	return software;
+}
+
+// Event predicate picking out the ShmCompletion event of an image sent
+// to the window of the context passed in arg
+Bool X11Context::isShmCompletion(Display* display, XEvent* event, XPointer arg)
+{
+	const X11Context* context = (const X11Context*)arg;
+	return event->type == context->shmCompletion &&
+		((XShmCompletionEvent*)event)->drawable == context->window;
+}
+
+// Creates the back buffer at the size of the window
+void X11Context::createBackBuffer()
+{
+	if (backBuffer != None)
+		XFreePixmap(display, backBuffer);
+
+	bufferWidth = getWindowWidth();
+	bufferHeight = getWindowHeight();
+	backBuffer = XCreatePixmap(display, window, bufferWidth, bufferHeight,
+				DefaultDepth(display, DefaultScreen(display)));
+	target = backBuffer;
+	framePresented = false;
+
+	clearBackBuffer();
+}
+
+// Fills the back buffer with the background color - unlike windows,
+// pixmaps have no background to clear to
+void X11Context::clearBackBuffer()
+{
+	if (mode != MODE_NORMAL)
+		XSetFunction(display, graphics_context, GXcopy);
+	XSetForeground(display, graphics_context, background);
+
+	XFillRectangle(display, backBuffer, graphics_context, 0, 0, bufferWidth, bufferHeight);
+
+	XSetForeground(display, graphics_context, color);
+	if (mode != MODE_NORMAL)
+		XSetFunction(display, graphics_context, GXxor);
+}
+
+// Copies an area of the back buffer to the window
+void X11Context::present(int x, int y, unsigned int width, unsigned int height)
+{
+	if (mode != MODE_NORMAL)
+		XSetFunction(display, graphics_context, GXcopy);
+
+	if (shmAttached)
+	{
+		XShmPutImage(display, window, graphics_context, frameImage,
+					x, y, x, y, width, height, True);
+		shmPending++;
+	}
+	else if (software)
+		XPutImage(display, window, graphics_context, frameImage,
+					x, y, x, y, width, height);
+	else
+		XCopyArea(display, backBuffer, window, graphics_context, x, y, width, height, x, y);
+
+	if (mode != MODE_NORMAL)
+		XSetFunction(display, graphics_context, GXxor);
+}
+
+// Makes drawing done outside of a frame visible
+void X11Context::finishImmediate()
+{
+	if (software || backBuffer != None)
+		present(0, 0, bufferWidth, bufferHeight);
+	XFlush(display);
+}
+
+// Returns the batch for the current color.  Consecutive drawing is
+// usually in one color, so the last batch used is checked first.
+X11Context::Batch& X11Context::currentBatch()
+{
+	if (lastBatch < batches.size() && batches[lastBatch].color == color)
+		return batches[lastBatch];
+
+	for (lastBatch = 0; lastBatch < batches.size(); lastBatch++)
+		if (batches[lastBatch].color == color)
+			return batches[lastBatch];
+
+	batches.push_back(Batch());
+	batches.back().color = color;
+	return batches.back();
+}
+
+// Sends all queued drawing to the server, one request per color for
+// as long as the request size allows, without flushing
+void X11Context::submit()
+{
+	for (size_t i = 0; i < batches.size(); i++)
+	{
+		Batch& batch = batches[i];
+		if (batch.segments.empty() && batch.points.empty())
+			continue;
+
+		XSetForeground(display, graphics_context, batch.color);
+
+		for (size_t first = 0; first < batch.segments.size(); first += maxSegments)
+		{
+			size_t count = std::min(maxSegments, batch.segments.size() - first);
+			XDrawSegments(display, target, graphics_context, &batch.segments[first], count);
+		}
+
+		for (size_t first = 0; first < batch.points.size(); first += maxPoints)
+		{
+			size_t count = std::min(maxPoints, batch.points.size() - first);
+			XDrawPoints(display, target, graphics_context, &batch.points[first], count,
+						CoordModeOrigin);
+		}
+
+		batch.segments.clear();
+		batch.points.clear();
+	}
+
+	XSetForeground(display, graphics_context, color);
+}
+
  
 
 // Run event loop
@@ -139,9 +578,33 @@ void X11Context::runLoop(DrawingBase* drawing)
 		XEvent e;
 		XNextEvent(display, &e);
 
-		// Exposure event - lets not worry about region
+		// Exposure event - with a back buffer holding the last frame the
+		// exposed area is simply copied back, otherwise the drawing is
+		// asked to repaint, lets not worry about region
 		if (e.type == Expose)
-			drawing->paint(this);
+		{
+			if ((software || backBuffer != None) && framePresented &&
+				bufferWidth == (unsigned int)getWindowWidth() &&
+				bufferHeight == (unsigned int)getWindowHeight())
+			{
+				present(e.xexpose.x, e.xexpose.y, e.xexpose.width, e.xexpose.height);
+				XFlush(display);
+			}
+			else
+			{
+				// the window may have been resized since the buffer was made.
+				// Without a new image the back buffer takes over, as when
+				// software rendering can not be started.
+				if (software)
+				{
+					if (!createImage())
+						createBackBuffer();
+				}
+				else if (backBuffer != None)
+					createBackBuffer();
+				drawing->paint(this);
+			}
+		}
 
 		// Key Down
 		else if (e.type == KeyPress)
@@ -176,38 +639,169 @@ void X11Context::runLoop(DrawingBase* drawing)
 			e.xmotion.x,
 			e.xmotion.y);
 
+		// Window resized
+		else if (e.type == ConfigureNotify)
+		{
+			windowWidth = e.xconfigure.width;
+			windowHeight = e.xconfigure.height;
+		}
+
 		// This will respond to the WM_DELETE_WINDOW from the
 		// window manager.
 		else if (e.type == ClientMessage)
 		break;
+
+		// A shared image has been read - only seen here if nothing was
+		// waiting for it
+		else if (e.type == shmCompletion && shmPending > 0)
+			shmPending--;
 	}
 }
 
 
 int X11Context::getWindowWidth()
 {
-	XWindowAttributes window_attributes;
-	XGetWindowAttributes(display,window, &window_attributes);
-	return window_attributes.width;
+	return windowWidth;
 }
 
 int X11Context::getWindowHeight()
 {
-	XWindowAttributes window_attributes;
-	XGetWindowAttributes(display,window, &window_attributes);
-	return window_attributes.height;
+	return windowHeight;
 }
 
 void X11Context::drawLine(int x1, int y1, int x2, int y2)
 {
-	XDrawLine(display, window, graphics_context, x1, y1, x2, y2);		
-	XFlush(display);
+	if (software)
+	{
+		softwareTarget()->drawLine(x1, y1, x2, y2);
+		if (!inFrame)
+			finishImmediate();
+		return;
+	}
+
+	// only the visible part is sent, which also keeps it within the
+	// 16 bit coordinates of the protocol
+	if (!clipLine(x1, y1, x2, y2, windowWidth, windowHeight))
+		return;
+
+	if (inFrame)
+	{
+		XSegment segment = {(short)x1, (short)y1, (short)x2, (short)y2};
+		currentBatch().segments.push_back(segment);
+		return;
+	}
+
+	XDrawLine(display, target, graphics_context, x1, y1, x2, y2);		
+	finishImmediate();
+}
+
+// Fill a horizontal run as one line
+void X11Context::fillSpan(int y, int x0, int x1)
+{
+	drawLine(x0, y, x1, y);
+}
+
+// Draw many lines, queued in a frame or sent as one request otherwise
+void X11Context::drawLines(const Segment* segments, unsigned int n)
+{
+	if (software)
+	{
+		softwareTarget()->drawLines(segments, n);
+		if (!inFrame)
+			finishImmediate();
+		return;
+	}
+
+	std::vector<XSegment> immediate;
+	std::vector<XSegment>& out = inFrame ? currentBatch().segments : immediate;
+
+	for (unsigned int i = 0; i < n; i++)
+	{
+		int x0 = segments[i].x0, y0 = segments[i].y0;
+		int x1 = segments[i].x1, y1 = segments[i].y1;
+
+		if (!clipLine(x0, y0, x1, y1, windowWidth, windowHeight))
+			continue;
+
+		XSegment segment = {(short)x0, (short)y0, (short)x1, (short)y1};
+		out.push_back(segment);
+	}
+
+	if (!inFrame)
+	{
+		for (size_t first = 0; first < immediate.size(); first += maxSegments)
+			XDrawSegments(display, target, graphics_context, &immediate[first],
+							std::min(maxSegments, immediate.size() - first));
+		finishImmediate();
+	}
+}
+
+// Set many pixels, queued in a frame or sent as one request otherwise
+void X11Context::setPixels(const Point* points, unsigned int n)
+{
+	if (software)
+	{
+		softwareTarget()->setPixels(points, n);
+		if (!inFrame)
+			finishImmediate();
+		return;
+	}
+
+	std::vector<XPoint> immediate;
+	std::vector<XPoint>& out = inFrame ? currentBatch().points : immediate;
+
+	for (unsigned int i = 0; i < n; i++)
+	{
+		// only the visible pixels are sent, as in drawLine
+		if (points[i].x < 0 || points[i].y < 0 ||
+			points[i].x >= windowWidth || points[i].y >= windowHeight)
+			continue;
+
+		XPoint point = {(short)points[i].x, (short)points[i].y};
+		out.push_back(point);
+	}
+
+	if (!inFrame)
+	{
+		for (size_t first = 0; first < immediate.size(); first += maxPoints)
+			XDrawPoints(display, target, graphics_context, &immediate[first],
+							std::min(maxPoints, immediate.size() - first), CoordModeOrigin);
+		finishImmediate();
+	}
+}
+
+// Fill a triangle - only the software renderer has a depth buffer
+void X11Context::fillTriangle(const float* x, const float* y, const float* depth)
+{
+	if (software)
+	{
+		softwareTarget()->fillTriangle(x, y, depth);
+		if (!inFrame)
+			finishImmediate();
+		return;
+	}
+
+	GraphicsContext::fillTriangle(x, y, depth);
 }
 
 void X11Context::drawCircle(int x, int y, int radius)
 {
-	XDrawArc(display, window, graphics_context, x-radius,
+	if (software)
+	{
+		softwareTarget()->drawCircle(x, y, radius);
+		if (!inFrame)
+			finishImmediate();
+		return;
+	}
+
+	// circles are not queued, but must still land on top of what is
+	if (inFrame)
+		submit();
+
+	XDrawArc(display, target, graphics_context, x-radius,
 				 y-radius, radius*2, radius*2, 0, 360*64);
-	XFlush(display);
+
+	if (!inFrame)
+		finishImmediate();
 }
 
@@ -0,0 +1,121 @@
+#!/bin/sh
+# Scripted regression checks for the headless renderer. Each check runs event
+# scripts through bin/shapes and compares the PPM frames they save, either with
+# frames that must come out the same another way or with known checksums.
+#
+# Run from the top of the tree, normally with "make test".
+
+SHAPES="$(pwd)/bin/shapes"
+TESTS="$(pwd)/tests"
+RESOURCES="$(pwd)/resources"
+WORK=$(mktemp -d) || exit 1
+trap 'rm -rf "$WORK"' EXIT
+failures=0
+
+# prepare <dir> <model> - makes a directory where the drawing loads model
+prepare() {
+    mkdir -p "$WORK/$1/resources"
+    cp "$2" "$WORK/$1/resources/cube.stl"
+}
+
+# render <dir> <script> [threads] - runs a script in a prepared directory
+render() {
+    (cd "$WORK/$1" && "$SHAPES" "$TESTS/$2" $3 > /dev/null 2>&1)
+}
+
+# same <dir> <dir> - true if both hold the same frames, and at least one
+same() {
+    [ -n "$(ls "$WORK/$1"/*.ppm 2> /dev/null)" ] || return 1
+    for frame in "$WORK/$1"/*.ppm; do
+        cmp -s "$frame" "$WORK/$2/$(basename "$frame")" || return 1
+    done
+}
+
+# le64 <number> - writes a number as 8 little-endian bytes, as in a mesh file
+le64() {
+    value=$1
+    for byte in 1 2 3 4 5 6 7 8; do
+        printf "\\$(printf %03o $((value & 255)))"
+        value=$((value >> 8))
+    done
+}
+
+# check <name> <command...> - reports whether the command succeeded
+check() {
+    name=$1
+    shift
+    if "$@"; then
+        echo "PASS $name"
+    else
+        echo "FAIL $name"
+        failures=$((failures + 1))
+    fi
+}
+
+# lines and faces crossing the near plane are cut where they cross it
+prepare near "$RESOURCES/word.stl"
+render near near.txt
+check "near plane clipping" sh -c "cd '$WORK/near' && md5sum -c --quiet '$TESTS/near.md5'"
+
+# filled frames do not depend on how many threads rasterize them
+for threads in 1 2 4; do
+    prepare filled$threads "$RESOURCES/word.stl"
+    render filled$threads filled.txt $threads
+done
+check "filled with 2 threads" same filled1 filled2
+check "filled with 4 threads" same filled1 filled4
+
+# binary, ASCII and chunked ASCII files of the same facets give the same mesh
+prepare ascii "$RESOURCES/word.stl"
+render ascii model.txt
+prepare binary "$TESTS/word_binary.stl"
+render binary model.txt
+check "binary and ASCII STL" same ascii binary
+
+# several copies of the model, so that the file is split into chunks
+large="$WORK/large.stl"
+head -n 1 "$RESOURCES/word.stl" > "$large"
+for copy in 1 2 3 4 5; do
+    sed '1d;$d' "$RESOURCES/word.stl" >> "$large"
+done
+tail -n 1 "$RESOURCES/word.stl" >> "$large"
+for threads in 1 4; do
+    prepare large$threads "$large"
+    STL_THREADS=$threads render large$threads model.txt
+done
+check "chunked ASCII STL" same large1 large4
+
+# a mesh cached on the first read is mapped back in on the next
+prepare cache "$RESOURCES/word.stl"
+render cache model.txt
+mkdir "$WORK/cached"
+cp "$WORK/cache"/*.ppm "$WORK/cached"
+check "mesh cache written" test -f "$WORK/cache/resources/cube.stl.mesh"
+render cache model.txt
+check "mesh cache round trip" same cache cached
+
+# a cache with its sections overwritten is not used, the STL is read again
+mesh="$WORK/cache/resources/cube.stl.mesh"
+size=$(wc -c < "$mesh")
+head -c $((size - 320)) /dev/zero | tr '\0' '\377' | dd of="$mesh" bs=320 seek=1 conv=notrunc 2> /dev/null
+rm -f "$WORK/cache"/*.ppm
+check "corrupt mesh cache" render cache model.txt
+check "corrupt mesh cache rejected" same cache cached
+
+# nor is one claiming to have no normals, which every finished mesh has - the
+# normals flag and the sizes of the three normal sections are cleared, and the
+# sections moved to the end of the file, where reading them would run off it
+check "mesh cache rewritten" test -f "$mesh"
+end=$(( $(wc -c < "$mesh") / 64 * 64 ))
+head -c 4 /dev/zero | dd of="$mesh" bs=1 seek=76 conv=notrunc 2> /dev/null
+{ le64 $end; le64 $end; le64 $end; } | dd of="$mesh" bs=1 seek=120 conv=notrunc 2> /dev/null
+head -c 24 /dev/zero | dd of="$mesh" bs=1 seek=216 conv=notrunc 2> /dev/null
+rm -f "$WORK/cache"/*.ppm
+check "mesh cache without normals" render cache model.txt
+check "mesh cache without normals rejected" same cache cached
+
+if [ $failures -ne 0 ]; then
+    echo "$failures checks failed"
+    exit 1
+fi
+echo "all checks passed"